@@ -36,7 +36,7 @@ bool AnnotItemBase::transCoords(const Coordinate& transCoords) {
   }
   return false;
 }
- 
+
 bool AnnotItemBase::isIntronic(const AnnotItemBase& other) const {
   // This function cannot be used for AITEM type as it has no children & intronic region is undefined
   if(other.getType()==AITEM || getChildren().isize()==0) { return false; }
@@ -331,30 +331,21 @@ void Annotation::writeGTF(ostream& sout) {
 
 void Annotation::copy(const Annotation& annot) {
   speciesId = annot.speciesId;
-  // Copy dynamically allocated memory
-  for(svec<AnnotItemBase*>::const_iterator it = annot.annotsByCoord.begin(); 
-  it != annot.annotsByCoord.end(); ++it) {
-    addAnnotItem(*dynamic_cast<AnnotItem*>(*it));
-  }
-  for(svec<AnnotItemBase*>::const_iterator it = annot.transByCoord.begin(); 
-  it != annot.transByCoord.end(); ++it) {
-    addTranscript(*dynamic_cast<Transcript*>(*it));
-  }
-  for(svec<AnnotItemBase*>::const_iterator it = annot.genesByCoord.begin(); 
-  it != annot.genesByCoord.end(); ++it) {
-    addGene(*dynamic_cast<Gene*>(*it));
-  }
-  for(svec<AnnotItemBase*>::const_iterator it = annot.lociByCoord.begin(); 
-  it != annot.lociByCoord.end(); ++it) {
-    addLocus(*dynamic_cast<Locus*>(*it));
-
-  }
+  setIndexType(annot.getIndexType());
+  // Copy each type into one block of its arena, then link the copies to each other
+  Placement placed(annot.annotsArena, annot.transArena, annot.genesArena, annot.lociArena);
+  placeItems(annot.annotsArena, annot.annotsByCoord, false, annotsArena, annotsByCoord, placed.order[AITEM]);
+  placeItems(annot.transArena,  annot.transByCoord,  false, transArena,  transByCoord,  placed.order[TRANS]);
+  placeItems(annot.genesArena,  annot.genesByCoord,  false, genesArena,  genesByCoord,  placed.order[GENE]);
+  placeItems(annot.lociArena,   annot.lociByCoord,   false, lociArena,   lociByCoord,   placed.order[LOCUS]);
+  relinkItems(placed);
   setNCLists();
 }
 
 // Sort the vectors and construct nested containment lists
 void Annotation::sortSetNCLists() {
   sortAll();
+  compactItems();
   setNCLists();
 }
  
@@ -364,10 +355,68 @@ void Annotation::sortAll() {
   sort(genesByCoord.begin(),  genesByCoord.end(), AnnotItemBase());
 }
 
+void Annotation::compactItems() {
+  ItemArena<AnnotItem>  annots;
+  ItemArena<Transcript> trans;
+  ItemArena<Gene>       genes;
+  ItemArena<Locus>      loci;
+  Placement placed(annots, trans, genes, loci);
+  compactArena(annotsArena, annotsByCoord, annots, placed.order[AITEM]);
+  compactArena(transArena,  transByCoord,  trans,  placed.order[TRANS]);
+  compactArena(genesArena,  genesByCoord,  genes,  placed.order[GENE]);
+  compactArena(lociArena,   lociByCoord,   loci,   placed.order[LOCUS]);
+  relinkItems(placed);
+}
+
+AnnotItemBase* Annotation::placedItem(const Placement& placed, AnnotItemBase* item) const {
+  if(item == NULL) { return NULL; }
+  int index = -1;
+  AnnotField type = item->getType();
+  switch(type) {
+    case AITEM: index = placed.annots.indexOf(static_cast<const AnnotItem*>(item));  break;
+    case TRANS: index = placed.trans.indexOf(static_cast<const Transcript*>(item));  break;
+    case GENE:  index = placed.genes.indexOf(static_cast<const Gene*>(item));        break;
+    case LOCUS: index = placed.loci.indexOf(static_cast<const Locus*>(item));        break;
+    default: break;
+  }
+  if(index < 0 || placed.order[type][index] < 0) { return item; }
+  return getDataByCoord(type)[placed.order[type][index]];
+}
+
+void Annotation::relinkItems(const Placement& placed) {
+  auto newItem = [&](AnnotItemBase* item) { return placedItem(placed, item); };
+  for(int mode=0; mode<4; mode++) {
+    const svec<AnnotItemBase*>& items = getDataByCoord(AnnotField(mode));
+    for(int i=0; i<items.isize(); i++) { items[i]->relink(newItem); }
+  }
+}
+
 void Annotation::setNCLists() {
-  annotsNCList.constructSublists(annotsByCoord);
-  transNCList.constructSublists(transByCoord);
-  genesNCList.constructSublists(genesByCoord);
+  chroms.clear();
+  for(int mode=0; mode<4; mode++) {
+    const svec<AnnotItemBase*>& items = getDataByCoord(AnnotField(mode));
+    for(int i=0; i<items.isize(); i++) {
+      if(i == 0 || items[i]->getChr() != items[i-1]->getChr()) { chroms.push_back(items[i]->getChr()); }
+    }
+  }
+  UniqueSort(chroms);
+  annotsIndex.build(annotsByCoord, chroms);
+  transIndex.build(transByCoord, chroms);
+  genesIndex.build(genesByCoord, chroms);
+  lociIndex.build(lociByCoord, chroms);
+}
+
+void Annotation::setIndexType(IntervalIndexType indexType) {
+  annotsIndex.setIndexType(indexType);
+  transIndex.setIndexType(indexType);
+  genesIndex.setIndexType(indexType);
+  lociIndex.setIndexType(indexType);
+}
+
+int Annotation::getChromId(const string& chr) const {
+  svec<string>::const_iterator it = lower_bound(chroms.begin(), chroms.end(), chr);
+  if(it == chroms.end() || *it != chr) { return -1; }
+  return (int)(it - chroms.begin());
 }
  
 const svec<AnnotItemBase*>& Annotation::setLoci() {
@@ -388,39 +437,33 @@ const svec<AnnotItemBase*>& Annotation::setLoci() {
       addLocus(loc);
     }
   }
-  lociNCList.constructSublists(lociByCoord);
+  lociIndex.build(lociByCoord, chroms);
   return lociByCoord;
 }
 
 int Annotation::getAnyOverlapping(AnnotItemBase* subject,
 AnnotField mode, svec<AnnotItemBase*>& results) const {
-  getNCListByCoord(mode).getAnyOverlapping(subject, results); // Return results
-  return results.isize();
+  return getAnyOverlapping(subject->getCoords(), mode, results); // Return results
 }
 
 int Annotation::getAnyOverlapping(const Coordinate& subject, 
 AnnotField mode, svec<AnnotItemBase*>& results) const {
-  AnnotItemBase tempItem(subject); // Make an object with the coordinates to pass onto NClist
-  getNCListByCoord(mode).getAnyOverlapping(&tempItem, results); // Return results
-  return results.isize();
+  // Only the partition of the subject's chromosome is searched
+  int chrom = getChromId(subject.getChr());
+  if(chrom == -1) { return results.isize(); }
+  return getIndexByCoord(mode).getAnyOverlapping(chrom, subject.getStart(), subject.getStop(), results);
 }
 
 int Annotation::getFullyContained(AnnotItemBase* subject, 
 AnnotField mode, svec<AnnotItemBase*>& results) const {
-  svec<AnnotItemBase*>::const_iterator lBound = lower_bound( getDataByCoord(mode).begin(), 
-                                                             getDataByCoord(mode).end(), 
-                                                             subject, AnnotItemBase());
-  // Scan forward from the lBound to find the overlapping items 
-  for(svec<AnnotItemBase*>::const_iterator it = lBound; it != getDataByCoord(mode).end() ; ++it) {
-    if(subject->getCoords().contains((*it)->getCoords())) { results.push_back(*it); }
-    else { break; } // Gone beyond any possible overlap
-  }
-  // Scan backward from the lBound to find the overlapping items
-  svec<AnnotItemBase*>::const_reverse_iterator rlBound(lBound);
-  for(svec<AnnotItemBase*>::const_reverse_iterator rit = rlBound; 
-  rit != getDataByCoord(mode).rend() ; ++rit) {
-    if(subject->getCoords().contains((*rit)->getCoords())) { results.push_back(*rit); }
-    else { break; } // Gone beyond any possible overlap
+  // Contained items are on the subject's chromosome, so only its partition is searched
+  int chrom = getChromId(subject->getChr());
+  if(chrom == -1) { return results.isize(); }
+  // The index finds the items within the subject's range, the subject decides on any other criteria
+  svec<AnnotItemBase*> candidates;
+  getIndexByCoord(mode).getContained(chrom, subject->getCoords().getStart(), subject->getCoords().getStop(), candidates);
+  for(int i=0; i<candidates.isize(); i++) {
+    if(subject->getCoords().contains(candidates[i]->getCoords())) { results.push_back(candidates[i]); }
   }
   return results.isize();
 }
@@ -431,22 +474,28 @@ AnnotField mode, svec<AnnotItemBase*>& results) const {
   return getFullyContained(&tempItem, mode, results); // Return size of results 
 }
 
+int Annotation::getNearest(const Coordinate& subject, 
+AnnotField mode, svec<AnnotItemBase*>& results) const {
+  int chrom = getChromId(subject.getChr());
+  if(chrom == -1) { return results.isize(); }
+  return getIndexByCoord(mode).getNearest(chrom, subject.getStart(), subject.getStop(), results);
+}
+
 void Annotation::clear() {
-  //Dealocate dynamically allocated memory
-  for(int mode=0; mode<4; mode++) {
-    for(svec<AnnotItemBase*>::const_iterator it = getDataByCoord(AnnotField(mode)).begin();
-        it != getDataByCoord(AnnotField(mode)).end() ; ++it) {
-      delete (*it);
-    }
-  }
+  // The arenas own all the items
+  annotsArena.clear();
+  transArena.clear();
+  genesArena.clear();
+  lociArena.clear();
+  chroms.clear();
   annotsByCoord.clear(); 
-  annotsNCList.clear();
+  annotsIndex.clear();
   transByCoord.clear();
-  transNCList.clear();  
+  transIndex.clear();  
   genesByCoord.clear(); 
-  genesNCList.clear();
+  genesIndex.clear();
   lociByCoord.clear();
-  lociNCList.clear(); 
+  lociIndex.clear(); 
 }
 
 void Annotation::cleanKeyValue(string& value) {
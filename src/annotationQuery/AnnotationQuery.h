@@ -7,11 +7,13 @@
 #include "ryggrad/src/base/SVector.h"
 #include "ryggrad/src/base/FileParser.h"
 #include "ryggrad/src/general/AlignmentBlock.h"
-#include "NCList.h"
+#include "ChromPartitions.h"
+#include "ItemArena.h"
 #include "ryggrad/src/general/Coordinate.h"
 
 // Forward declaration 
 class Annotation; 
+class AnnotItemBase;
 
 //======================================================
 /** Annotation Item's Auxilliary data (key-value pairs) */
@@ -56,8 +58,13 @@ enum AnnotField { AITEM, TRANS, GENE, LOCUS, NONE };
 class AnnotItemBase
 {
 public:
-  AnnotItemBase(): coords(), children(), exons(), parent(NULL), transferredCoords(false), sublistIndex(-1) {}
-  AnnotItemBase(const Coordinate& crds): coords(crds), children(), exons(), parent(NULL), transferredCoords(false), sublistIndex(-1) {}
+  AnnotItemBase(): coords(), children(), exons(), parent(NULL), transferredCoords(false) {}
+  AnnotItemBase(const Coordinate& crds): coords(crds), children(), exons(), parent(NULL), transferredCoords(false) {}
+
+  AnnotItemBase(const AnnotItemBase&) = default;
+  AnnotItemBase(AnnotItemBase&&) = default;
+  AnnotItemBase& operator=(const AnnotItemBase&) = default;
+  AnnotItemBase& operator=(AnnotItemBase&&) = default;
 
   virtual ~AnnotItemBase() {}
 
@@ -81,11 +88,15 @@ public:
   void setParentNode(AnnotItemBase* pNode)              { parent = pNode;             }
   bool getTransferred() const                           { return transferredCoords;   }
   void setTransferred(bool flag)                        { transferredCoords = flag;   }
-  int  getSublist() const                               { return sublistIndex;        }
-  void setSublist(int sli)                              { sublistIndex = sli;         }
-  bool hasSublist() const                               { return (sublistIndex!=-1);  }
   virtual bool isSameOrient(AnnotItemBase* other)const  { return coords.isSameOrient(other->getCoords());   } 
   bool contains(const AnnotItemBase& other) const       { return( getCoords().contains(other.getCoords())); }
+  /** Points the parent, children, and exons at the items newItem returns for them */
+  template<class NewItem>
+  void relink(const NewItem& newItem) {
+    parent = newItem(parent);
+    for(int i=0; i<children.isize(); i++) { children[i] = newItem(children[i]); }
+    for(int i=0; i<exons.isize(); i++)    { exons[i]    = newItem(exons[i]);    }
+  }
   /** Checks if the whole of the given item falls within one intronic/intergenic region */
   bool isIntronic(const AnnotItemBase& other) const;
   /** Return the length of the coordinate by subtracting start from stop (absolute value) */
@@ -150,9 +161,6 @@ public:
   svec<AnnotItemBase*> exons;      /// list of pointers to Exons that this item constitutes of (only applies to Transcripts) 
   AnnotItemBase* parent;           /// Pointer to parent (either a gene for transcripts or a transcript for annoItems)
   bool transferredCoords;          /// Flag identifies if the coordinates of this item  have been transferred into another space (annotation)
-
-private:
-  int sublistIndex;                /// The index of a sublist associated with this interval (if any, if not -1)
 };
 
 //======================================================
@@ -307,7 +315,9 @@ struct CompareGeneTransIdLess {
  */
 class Annotation {
 public:
-  Annotation(const string& fileName, const string& specie) {
+  /** The interval index answering the queries is chosen by indexType (see IntervalIndex.h) */
+  Annotation(const string& fileName, const string& specie, IntervalIndexType indexType = NCLIST_INDEX) {
+    setIndexType(indexType);
     readGTF(fileName, specie);
   }
 
@@ -323,6 +333,12 @@ public:
   ~Annotation() { clear(); }
   
   const string& getSpecieId() const { return speciesId; }
+  IntervalIndexType getIndexType() const { return annotsIndex.getIndexType(); }
+
+  /** Sorted names of the chromosomes of all items */
+  const svec<string>& getChroms() const { return chroms; }
+  /** Index of the chromosome in getChroms(), -1 if there is no item on it */
+  int getChromId(const string& chr) const;
 
   /** Mode 0: Annotation Items, Mode 1: Transcripts, Mode 2: Genes, Mode 3: Loci */
   const svec<AnnotItemBase*>& getDataByCoord(AnnotField type) const { 
@@ -353,7 +369,7 @@ public:
   int getAnyOverlapping(const Coordinate& subject, AnnotField mode, svec<AnnotItemBase*>& results) const;     
 
   /** 
-   * Return objects fully containing the given coordinates in the results object passed in by user.
+   * Return objects fully contained in the given coordinates in the results object passed in by user.
    * By choosing the right mode you can obtain of the following:
    * AITEM:  annotationItems, TRANS: transcripts, GENE: genes, or LOCUS: Loci
    * Returns integer represnting the number of items found
@@ -361,6 +377,13 @@ public:
   int getFullyContained(AnnotItemBase* subject, AnnotField mode, svec<AnnotItemBase*>& results) const;     
   /** Same as other overload but with AICoord as input instead of AnnotItem */
   int getFullyContained(const Coordinate& subject, AnnotField mode, svec<AnnotItemBase*>& results) const;     
+
+  /** 
+   * Return the objects overlapping the given coordinates, or if there are none the nearest object
+   * on either side (both if they are equally far) in the results object passed in by user.
+   * Returns integer represnting the number of items found
+   */
+  int getNearest(const Coordinate& subject, AnnotField mode, svec<AnnotItemBase*>& results) const;
  
   /** Returns number of items of the same type as the query where all or some
    * of  their child nodes have overlaps. The overlapMode parameter determines
@@ -385,6 +408,9 @@ protected:
    */
   void copy(const Annotation& annot);
 
+  /** Index type of all the items, applied when the indexes are next built */
+  void setIndexType(IntervalIndexType indexType);
+
   /** Read the give GTF file into the rlevant annotation/transcript/gene structures */
   void readGTF(const string& fileName, const string& specie);
 
@@ -392,13 +418,66 @@ protected:
   void sortSetNCLists();
   void sortAll(); 
   void setNCLists();
+  /** Lays the items of each type out in their arena in the order of the sorted vectors */
+  void compactItems();
+
+  /** 
+   * The arenas items were placed from (see placeItems) and, by the type and the index of each
+   * item in its arena, the position of the item placed from it in the ByCoord vector (-1 if none)
+   */
+  struct Placement {
+    Placement(const ItemArena<AnnotItem>& a, const ItemArena<Transcript>& t,
+              const ItemArena<Gene>& g, const ItemArena<Locus>& l)
+      : annots(a), trans(t), genes(g), loci(l) {}
+
+    const ItemArena<AnnotItem>&  annots;
+    const ItemArena<Transcript>& trans;
+    const ItemArena<Gene>&       genes;
+    const ItemArena<Locus>&      loci;
+    svec<int> order[LOCUS+1];
+  };
+  /** The item placed from the given one, the given one itself if it was not placed */
+  AnnotItemBase* placedItem(const Placement& placed, AnnotItemBase* item) const;
+  /** Relinks all items placed as recorded in placed */
+  void relinkItems(const Placement& placed);
+
+  /** 
+   * Adds copies of the given items (of ItemType, owned by fromArena) to arena and items, moving them
+   * instead if moveItems is set. Records their positions in items in order, see Placement, their links
+   * are left as they were.
+   */
+  template<class ItemType>
+  static void placeItems(const ItemArena<ItemType>& fromArena, const svec<AnnotItemBase*>& from, bool moveItems,
+                         ItemArena<ItemType>& arena, svec<AnnotItemBase*>& items, svec<int>& order) {
+    arena.reserve(from.isize());
+    items.reserve(items.isize() + from.isize());
+    order.assign(fromArena.isize(), -1);
+    for(int i=0; i<from.isize(); i++) {
+      ItemType* item = static_cast<ItemType*>(from[i]);
+      order[fromArena.indexOf(item)] = items.isize();
+      items.push_back(moveItems ? arena.add(std::move(*item)) : arena.add(*item));
+    }
+  }
+
+  /** 
+   * Moves the items (of ItemType) into a fresh arena in their order, see compactItems. The moved-from
+   * items are left in old until the links to them are pointed at the new ones.
+   */
+  template<class ItemType>
+  static void compactArena(ItemArena<ItemType>& arena, svec<AnnotItemBase*>& items,
+                           ItemArena<ItemType>& old, svec<int>& order) {
+    svec<AnnotItemBase*> sorted;
+    arena.swap(old);
+    items.swap(sorted);
+    placeItems(old, sorted, true, arena, items, order);
+  }
 
   /** 
    * Returns the pointer to object that has been added
    * so that it can be used for links to transcripts
    */
   AnnotItemBase* addAnnotItem(const AnnotItem& i) { 
-    AnnotItemBase* newItem = new AnnotItem(i);
+    AnnotItemBase* newItem = annotsArena.add(i);
     annotsByCoord.push_back(newItem);
     return newItem;
   }
@@ -408,7 +487,7 @@ protected:
    * so that it can be used for links to genes 
    */
   AnnotItemBase* addTranscript(const Transcript& t) { 
-    AnnotItemBase* newItem = new Transcript(t);
+    AnnotItemBase* newItem = transArena.add(t);
     transByCoord.push_back(newItem);
     for(int i=0; i<t.getChildren().isize(); i++) {
       t.getChildren()[i]->setParentNode(newItem);
@@ -420,7 +499,7 @@ protected:
    * Returns the pointer to object that has been added
    */
   AnnotItemBase* addGene(const Gene& g) { 
-    AnnotItemBase* newItem = new Gene(g);
+    AnnotItemBase* newItem = genesArena.add(g);
     genesByCoord.push_back(newItem);
     for(int i=0; i<g.getChildren().isize(); i++) {
       g.getChildren()[i]->setParentNode(newItem);
@@ -432,26 +511,26 @@ protected:
    * Returns the pointer to object that has been added
    */
   AnnotItemBase* addLocus(const Locus& l) { 
-    AnnotItemBase* newItem = new Locus(l);
+    AnnotItemBase* newItem = lociArena.add(l);
     lociByCoord.push_back(newItem);
     return newItem;
   }
 
   /** Mode 0: Annotation Items, Mode 1: Transcripts, Mode 2: Genes, Mode 3: Loci */
-  const NCList<AnnotItemBase>& getNCListByCoord(AnnotField type) const { 
+  const ChromPartitions<AnnotItemBase>& getIndexByCoord(AnnotField type) const { 
     switch(type) {
       case AITEM:
-        return annotsNCList;
+        return annotsIndex;
         break;
       case TRANS:
-        return transNCList;
+        return transIndex;
         break;
       case GENE:
-        return genesNCList;
+        return genesIndex;
         break;
       case LOCUS:
       default:
-        return lociNCList;
+        return lociIndex;
     }
   }
 
@@ -460,14 +539,19 @@ protected:
 
 
   string speciesId;                    /// The specie to which the annotation belongs 
+  svec<string>          chroms;        /// Sorted names of the chromosomes of all items, giving the chromosome ids
   svec<AnnotItemBase*>  annotsByCoord; /// Annotation items sorted by the coordinates 
-  NCList<AnnotItemBase> annotsNCList;  /// Annotation items None-containment Lists 
+  ChromPartitions<AnnotItemBase> annotsIndex;  /// Annotation items by chromosome with their interval indexes 
   svec<AnnotItemBase*>  transByCoord;  /// Transcripts sorted by the coordinates
-  NCList<AnnotItemBase> transNCList;   /// Transcripts None-containment Lists
+  ChromPartitions<AnnotItemBase> transIndex;   /// Transcripts by chromosome with their interval indexes
   svec<AnnotItemBase*>  genesByCoord;  /// Genes sorted by the coordinates
-  NCList<AnnotItemBase> genesNCList;   /// Genes None-containment lists
+  ChromPartitions<AnnotItemBase> genesIndex;   /// Genes by chromosome with their interval indexes
   svec<AnnotItemBase*>  lociByCoord;   /// Loci sorted by the coordinates
-  NCList<AnnotItemBase> lociNCList;    /// Loci None-containment lists
+  ChromPartitions<AnnotItemBase> lociIndex;    /// Loci by chromosome with their interval indexes
+  ItemArena<AnnotItem>  annotsArena;   /// Owns the annotation items
+  ItemArena<Transcript> transArena;    /// Owns the transcripts
+  ItemArena<Gene>       genesArena;    /// Owns the genes
+  ItemArena<Locus>      lociArena;     /// Owns the loci
 };
 
 /**
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include "ryggrad/src/base/CommandLineParser.h"
+#include "AnnotationQuery.h"
+
+// Benchmark of the interval index backends: the same GTF is loaded with an NCList and with an
+// implicit interval tree, and the same random overlap and nearest item queries are timed on both.
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs the queries, returns the total number of items found and sets the time taken
+static long long RunQueries(const Annotation& annot, const svec<Coordinate>& lookups, bool nearest, double& seconds)
+{
+  svec<AnnotItemBase*> results;
+  long long found = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int i=0; i<lookups.isize(); i++) {
+    results.clear();
+    found += (nearest ? annot.getNearest(lookups[i], AITEM, results) : annot.getAnyOverlapping(lookups[i], AITEM, results));
+  }
+  seconds = Seconds(start);
+  return found;
+}
+
+int main(int argc,char** argv)
+{
+  commandArg<string> gtfCmmd("-i", "GTF file whose items are queried (e.g. a genome-wide annotation)");
+  commandArg<int>    queryCmmd("-q", "Number of random queries of each kind", 1000000);
+  commandArg<int>    lengthCmmd("-l", "Maximum length of a query", 10000);
+  commandArg<int>    seedCmmd("-s", "Random seed", 1);
+  commandLineParser P(argc,argv);
+  P.SetDescription("Times overlap and nearest item queries through an NCList and an implicit interval tree.");
+  P.registerArg(gtfCmmd);
+  P.registerArg(queryCmmd);
+  P.registerArg(lengthCmmd);
+  P.registerArg(seedCmmd);
+  P.parse();
+  string gtfFile = P.GetStringValueFor(gtfCmmd);
+  int queries    = max(1, P.GetIntValueFor(queryCmmd));
+  int maxLength  = max(1, P.GetIntValueFor(lengthCmmd));
+  int seed       = P.GetIntValueFor(seedCmmd);
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  Annotation ncList(gtfFile, "query", NCLIST_INDEX);
+  double ncListLoad = Seconds(start);
+  start = std::chrono::steady_clock::now();
+  Annotation tree(gtfFile, "query", INTERVAL_TREE_INDEX);
+  double treeLoad = Seconds(start);
+  const svec<AnnotItemBase*>& items = ncList.getDataByCoord(AITEM);
+  if(items.empty()) {
+    cout << "No items in " << gtfFile << endl;
+    return 1;
+  }
+
+  // Queries on the chromosomes of random items, anywhere up to past the last item's end
+  std::mt19937 rng(seed);
+  svec<Coordinate> lookups;
+  lookups.resize(queries);
+  for(int i=0; i<queries; i++) {
+    const Coordinate& c = items[rng() % items.isize()]->getCoords();
+    int begin = (int)(rng() % (uint32_t)(c.getStop() + maxLength));
+    lookups[i].set(c.getChr(), true, begin, begin + (int)(rng() % maxLength));
+  }
+
+  double ncListOverlap, treeOverlap, ncListNearest, treeNearest;
+  long long ncListFound  = RunQueries(ncList, lookups, false, ncListOverlap);
+  long long treeFound    = RunQueries(tree, lookups, false, treeOverlap);
+  long long ncListNear   = RunQueries(ncList, lookups, true, ncListNearest);
+  long long treeNear     = RunQueries(tree, lookups, true, treeNearest);
+
+  cout << "Items: " << items.isize() << ", queries: " << queries << endl;
+  cout << "Load (GTF parsing included): NCList " << ncListLoad << " s, interval tree " << treeLoad << " s" << endl;
+  cout << "Overlap queries: NCList " << 1e9 * ncListOverlap / queries << " ns, interval tree "
+       << 1e9 * treeOverlap / queries << " ns per query (" << ncListFound << " items found)" << endl;
+  cout << "Nearest queries: NCList " << 1e9 * ncListNearest / queries << " ns, interval tree "
+       << 1e9 * treeNearest / queries << " ns per query (" << ncListNear << " items found)" << endl;
+  if(ncListFound != treeFound || ncListNear != treeNear) {
+    cout << "The backends found different numbers of items (" << treeFound << " and " << treeNear
+         << " with the interval tree)" << endl;
+    return 1;
+  }
+  return 0;
+}
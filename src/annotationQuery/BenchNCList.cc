@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <random>
+#include <string>
+#include "ryggrad/src/base/CommandLineParser.h"
+#include "AnnotationQuery.h"
+#include "NCList.h"
+
+// Random overlap queries against the items of a GTF file, through the NCList query path and through
+// the recursive query it replaced (kept below as BaselineNCList), with the results checked to agree.
+
+//======================================================
+/** Interval of the baseline list, which keeps the sublist index of an interval on the interval */
+struct BaselineInterval
+{
+  BaselineInterval(): coords(), item(NULL), sublist(-1) {}
+
+  const Coordinate& getCoords() const                 { return coords;                          }
+  bool contains(const BaselineInterval& other) const  { return coords.contains(other.coords);   }
+  bool hasSublist() const                             { return sublist != -1;                   }
+  int  getSublist() const                             { return sublist;                         }
+  void setSublist(int s)                              { sublist = s;                            }
+  bool operator()(const BaselineInterval* a, const BaselineInterval* b) const { return a->coords < b->coords; }
+
+  Coordinate coords;
+  AnnotItemBase* item;
+  int sublist;
+};
+
+/** Sublists and query of NCList before the query walked the sublists by reference */
+class BaselineNCList
+{
+public:
+  void constructSublists(const svec<BaselineInterval*>& input);
+  int getAnyOverlapping(BaselineInterval* subject, svec<BaselineInterval*>& results) const {
+    if(!sublists.empty()) { getOverlapsFromSublist(subject, 0, results); }
+    return results.isize();
+  }
+
+private:
+  typedef svec<BaselineInterval*> Sublist;
+
+  static void getAnyOverlaps(const Sublist& intervals, BaselineInterval* subject, svec<BaselineInterval*>& results);
+  void getOverlapsFromSublist(BaselineInterval* subject, int sublistIndex, svec<BaselineInterval*>& results) const;
+  int addNewSublist(BaselineInterval* interval) {
+    sublists.push_back(Sublist());
+    sublists.back().push_back(interval);
+    return sublists.isize() - 1;
+  }
+
+  svec<Sublist> sublists;
+};
+
+void BaselineNCList::getAnyOverlaps(const Sublist& intervals, BaselineInterval* subject, svec<BaselineInterval*>& results)
+{
+  Sublist::const_iterator lBound = lower_bound(intervals.begin(), intervals.end(), subject, BaselineInterval());
+  for(Sublist::const_iterator it = lBound; it != intervals.end(); ++it) {
+    if(subject->getCoords().hasOverlap((*it)->getCoords())) { results.push_back(*it); }
+    else { break; }
+  }
+  Sublist::const_reverse_iterator rit(lBound);
+  for(; rit != intervals.rend(); ++rit) {
+    if(subject->getCoords().hasOverlap((*rit)->getCoords())) { results.push_back(*rit); }
+    else { break; }
+  }
+}
+
+void BaselineNCList::constructSublists(const svec<BaselineInterval*>& input)
+{
+  sublists.clear();
+  if(input.empty()) { return; }
+  std::list<int> stack;
+  svec<BaselineInterval*>::const_iterator it = input.begin();
+  stack.push_front(addNewSublist(*it));
+  for(it = it + 1; it != input.end(); ++it) {
+    while(!stack.empty()) {
+      BaselineInterval* last = sublists[stack.front()].back();
+      if(last->contains(**it)) {
+        if(last->hasSublist()) {
+          sublists[last->getSublist()].push_back(*it);
+          stack.push_front(last->getSublist());
+        } else {
+          int slIndex = addNewSublist(*it);
+          last->setSublist(slIndex);
+          stack.push_front(slIndex);
+        }
+        break;
+      } else {
+        stack.pop_front();
+        if(stack.empty()) {
+          sublists[0].push_back(*it);
+          stack.push_front(0);
+          break;
+        }
+      }
+    }
+  }
+}
+
+void BaselineNCList::getOverlapsFromSublist(BaselineInterval* subject, int sublistIndex, svec<BaselineInterval*>& results) const
+{
+  Sublist slist = sublists[sublistIndex];   // The copy and the temporary below are what the current query avoids
+  svec<BaselineInterval*> out;
+  getAnyOverlaps(slist, subject, out);
+  for(svec<BaselineInterval*>::iterator it = out.begin(); it != out.end(); ++it) {
+    results.push_back(*it);
+    if((*it)->hasSublist()) { getOverlapsFromSublist(subject, (*it)->getSublist(), results); }
+  }
+}
+
+//======================================================
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc,char** argv)
+{
+  commandArg<string> gtfCmmd("-i", "GTF file whose items are queried (e.g. a genome-wide annotation)");
+  commandArg<int>    queryCmmd("-q", "Number of random queries", 1000000);
+  commandArg<int>    lengthCmmd("-l", "Maximum length of a query", 10000);
+  commandArg<int>    seedCmmd("-s", "Random seed", 1);
+  commandLineParser P(argc,argv);
+  P.SetDescription("Times random overlap queries through the NCList and through the recursive query it replaced.");
+  P.registerArg(gtfCmmd);
+  P.registerArg(queryCmmd);
+  P.registerArg(lengthCmmd);
+  P.registerArg(seedCmmd);
+  P.parse();
+  string gtfFile = P.GetStringValueFor(gtfCmmd);
+  int queries    = P.GetIntValueFor(queryCmmd);
+  int maxLength  = max(1, P.GetIntValueFor(lengthCmmd));
+  int seed       = P.GetIntValueFor(seedCmmd);
+
+  Annotation annot(gtfFile, "query");
+  const svec<AnnotItemBase*>& items = annot.getDataByCoord(AITEM);
+  if(items.empty()) {
+    cout << "No items in " << gtfFile << endl;
+    return 1;
+  }
+
+  // Both lists index the items in coordinate order, the baseline through its own intervals
+  svec<BaselineInterval> baselineItems;
+  baselineItems.resize(items.isize());
+  svec<BaselineInterval*> baselineInput;
+  for(int i=0; i<items.isize(); i++) {
+    baselineItems[i].coords = items[i]->getCoords();
+    baselineItems[i].item   = items[i];
+    baselineInput.push_back(&baselineItems[i]);
+  }
+  BaselineNCList baseline;
+  baseline.constructSublists(baselineInput);
+  NCList<AnnotItemBase> current;
+  current.constructSublists(items);
+
+  // Queries on the chromosomes of random items, anywhere up to past the last item's end
+  std::mt19937 rng(seed);
+  svec<Coordinate> lookups;
+  lookups.resize(queries);
+  for(int i=0; i<queries; i++) {
+    const Coordinate& c = items[rng() % items.isize()]->getCoords();
+    int start = (int)(rng() % (uint32_t)(c.getStop() + maxLength));
+    lookups[i].set(c.getChr(), true, start, start + (int)(rng() % maxLength));
+  }
+
+  svec<BaselineInterval*> baselineResults;
+  long long baselineHits = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  BaselineInterval subject;
+  for(int i=0; i<queries; i++) {
+    subject.coords = lookups[i];
+    baselineResults.clear();
+    baselineHits += baseline.getAnyOverlapping(&subject, baselineResults);
+  }
+  double baselineTime = Seconds(start);
+
+  svec<AnnotItemBase*> currentResults;
+  long long currentHits = 0;
+  start = std::chrono::steady_clock::now();
+  for(int i=0; i<queries; i++) {
+    currentResults.clear();
+    currentHits += current.getAnyOverlapping(lookups[i].getChr(), lookups[i].getStart(), lookups[i].getStop(), currentResults);
+  }
+  double currentTime = Seconds(start);
+
+  // Same items in the same order
+  int mismatches = 0;
+  for(int i=0; i<queries && i<100000; i++) {
+    subject.coords = lookups[i];
+    baselineResults.clear();
+    currentResults.clear();
+    baseline.getAnyOverlapping(&subject, baselineResults);
+    current.getAnyOverlapping(lookups[i].getChr(), lookups[i].getStart(), lookups[i].getStop(), currentResults);
+    bool same = (baselineResults.isize() == currentResults.isize());
+    for(int k=0; same && k<currentResults.isize(); k++) { same = (baselineResults[k]->item == currentResults[k]); }
+    if(!same) { mismatches++; }
+  }
+
+  cout << "Items: " << items.isize() << ", queries: " << queries << ", overlaps found: " << currentHits << endl;
+  cout << "Recursive query: " << baselineTime << " s (" << 1e9 * baselineTime / max(1, queries) << " ns per query)" << endl;
+  cout << "NCList query:    " << currentTime << " s (" << 1e9 * currentTime / max(1, queries) << " ns per query)" << endl;
+  if(mismatches > 0 || baselineHits != currentHits) {
+    cout << "NCList results differ from the recursive query (" << mismatches << " mismatches)" << endl;
+    return 1;
+  }
+  return 0;
+}
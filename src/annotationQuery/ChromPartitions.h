@@ -0,0 +1,100 @@
+#ifndef _CHROM_PARTITIONS_H_
+#define _CHROM_PARTITIONS_H_
+
+#include <string>
+#include <memory>
+#include "ryggrad/src/base/SVector.h"
+#include "IntervalIndex.h"
+#include "IntervalTree.h"
+
+//======================================================
+/**
+ * Items sorted by coordinates, split by chromosome into partitions that each
+ * hold their own sorted items and interval index. Chromosomes are
+ * given by their id in a sorted table of names (see Annotation::getChromId),
+ * so a query goes straight to its partition and only searches the items of
+ * that chromosome. The partitions are independent of each other and could be
+ * built or queried in parallel. The kind of index is chosen at construction.
+ */
+template<class IntervalType>
+class ChromPartitions {
+public:
+  ChromPartitions(IntervalIndexType type = NCLIST_INDEX): partitions(), indexType(type) {}
+
+  void clear() { partitions.clear(); }
+
+  IntervalIndexType getIndexType() const { return indexType; }
+  /** Takes effect with the next build */
+  void setIndexType(IntervalIndexType type) { indexType = type; }
+
+  /** Splits the items (sorted by coordinates) by chromosome, chroms being the sorted names giving the ids */
+  void build(const svec<IntervalType*>& sorted, const svec<string>& chroms);
+
+  int  getChromCount() const { return partitions.isize(); }
+  /** Items on the given chromosome sorted by coordinates */
+  const svec<IntervalType*>& getItems(int chrom) const { return partitions[chrom].items; }
+
+  /** Appends the items on chromosome chrom overlapping [start, stop], returns the size of results */
+  int getAnyOverlapping(int chrom, int start, int stop, svec<IntervalType*>& results) const {
+    if(hasIndex(chrom)) { partitions[chrom].index->getAnyOverlapping(start, stop, results); }
+    return results.isize();
+  }
+  /** Same as above for the items lying within [start, stop] */
+  int getContained(int chrom, int start, int stop, svec<IntervalType*>& results) const {
+    if(hasIndex(chrom)) { partitions[chrom].index->getContained(start, stop, results); }
+    return results.isize();
+  }
+  /** Same as above for the items nearest to [start, stop] (see IntervalIndex::getNearest) */
+  int getNearest(int chrom, int start, int stop, svec<IntervalType*>& results) const {
+    if(hasIndex(chrom)) { partitions[chrom].index->getNearest(start, stop, results); }
+    return results.isize();
+  }
+
+private:
+  struct Partition {
+    svec<IntervalType*> items;                          /// Items of the chromosome sorted by coordinates
+    std::unique_ptr<IntervalIndex<IntervalType> > index; /// Index over items
+  };
+
+  bool hasIndex(int chrom) const { return chrom >= 0 && chrom < partitions.isize() && partitions[chrom].index; }
+  IntervalIndex<IntervalType>* newIndex() const;
+
+  svec<Partition> partitions;  /// By chromosome id
+  IntervalIndexType indexType;
+};
+
+//======================================================
+template<class IntervalType>
+void ChromPartitions<IntervalType>::build(const svec<IntervalType*>& sorted, const svec<string>& chroms)
+{
+  partitions.clear();
+  partitions.resize(chroms.isize());
+  int chrom = -1;
+  for(int i=0; i<sorted.isize(); i++) {
+    const string& chr = sorted[i]->getCoords().getChr();
+    if(chrom == -1 || chroms[chrom] != chr) {  // Items of one chromosome are next to each other
+      svec<string>::const_iterator it = lower_bound(chroms.begin(), chroms.end(), chr);
+      if(it == chroms.end() || *it != chr) { chrom = -1; continue; }
+      chrom = (int)(it - chroms.begin());
+    }
+    partitions[chrom].items.push_back(sorted[i]);
+  }
+  for(int c=0; c<partitions.isize(); c++) {
+    partitions[c].index.reset(newIndex());
+    partitions[c].index->build(partitions[c].items);
+  }
+}
+
+template<class IntervalType>
+IntervalIndex<IntervalType>* ChromPartitions<IntervalType>::newIndex() const
+{
+  switch(indexType) {
+    case INTERVAL_TREE_INDEX:
+      return new ImplicitIntervalTree<IntervalType>();
+    case NCLIST_INDEX:
+    default:
+      return new NCListIndex<IntervalType>();
+  }
+}
+
+#endif //_CHROM_PARTITIONS_H_
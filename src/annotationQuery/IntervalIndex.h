@@ -0,0 +1,111 @@
+#ifndef _INTERVAL_INDEX_H_
+#define _INTERVAL_INDEX_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include "ryggrad/src/base/SVector.h"
+#include "NCList.h"
+
+/** Data structure answering the interval queries of one chromosome (see ChromPartitions) */
+enum IntervalIndexType { NCLIST_INDEX, INTERVAL_TREE_INDEX };
+
+//======================================================
+/**
+ * Interval queries over the items of one chromosome, with inclusive start and
+ * stop coordinates. Each query appends to results and returns its size.
+ */
+template<class IntervalType>
+class IntervalIndex
+{
+public:
+  virtual ~IntervalIndex() {}
+
+  /** Builds the index over the items of one chromosome sorted by their coordinates */
+  virtual void build(const svec<IntervalType*>& sorted) = 0;
+  /** Items overlapping [start, stop] */
+  virtual int getAnyOverlapping(int start, int stop, svec<IntervalType*>& results) const = 0;
+  /** Items lying within [start, stop], in order of their coordinates */
+  virtual int getContained(int start, int stop, svec<IntervalType*>& results) const = 0;
+  /**
+   * Items overlapping [start, stop] if there are any, otherwise the closest item ending before
+   * start and/or the closest one starting after stop (both if they are equally close)
+   */
+  virtual int getNearest(int start, int stop, svec<IntervalType*>& results) const = 0;
+};
+
+//======================================================
+/**
+ * Base of the indexes keeping the items as packed starts and stops in sorted
+ * order, which is all that containment and nearest neighbour queries need.
+ * The overlap query is left to the derived classes.
+ */
+template<class IntervalType>
+class SortedIntervalIndex: public IntervalIndex<IntervalType>
+{
+public:
+  SortedIntervalIndex(): starts(), stops(), items(), maxStopAt() {}
+
+  void build(const svec<IntervalType*>& sorted) {
+    int n = sorted.isize();
+    starts.resize(n);
+    stops.resize(n);
+    items = sorted;
+    maxStopAt.resize(n);
+    for(int i=0; i<n; i++) {
+      starts[i] = sorted[i]->getCoords().getStart();
+      stops[i]  = sorted[i]->getCoords().getStop();
+      maxStopAt[i] = (i > 0 && stops[maxStopAt[i-1]] >= stops[i] ? maxStopAt[i-1] : i);
+    }
+  }
+
+  int getContained(int start, int stop, svec<IntervalType*>& results) const {
+    // Contained items start within the range, where they are ordered by start
+    int i = (int)(std::lower_bound(starts.begin(), starts.end(), start) - starts.begin());
+    for(; i<starts.isize() && starts[i] <= stop; i++) {
+      if(stops[i] <= stop) { results.push_back(items[i]); }
+    }
+    return results.isize();
+  }
+
+  int getNearest(int start, int stop, svec<IntervalType*>& results) const {
+    int found = results.isize();
+    this->getAnyOverlapping(start, stop, results);
+    if(results.isize() > found || starts.empty()) { return results.isize(); }
+    // Nothing overlaps, so the items starting up to stop all end before start
+    int after = (int)(std::upper_bound(starts.begin(), starts.end(), stop) - starts.begin());
+    long long gapBefore = (after > 0 ? (long long)start - stops[maxStopAt[after-1]] : -1);
+    long long gapAfter  = (after < starts.isize() ? (long long)starts[after] - stop : -1);
+    if(gapBefore > 0 && (gapAfter < 0 || gapBefore <= gapAfter)) { results.push_back(items[maxStopAt[after-1]]); }
+    if(gapAfter > 0 && (gapBefore < 0 || gapAfter <= gapBefore))  { results.push_back(items[after]); }
+    return results.isize();
+  }
+
+protected:
+  svec<int32_t> starts;            /// Item starts in sorted order
+  svec<int32_t> stops;             /// Item stops in the same order
+  svec<IntervalType*> items;
+  svec<int32_t> maxStopAt;         /// Position of the item with the largest stop among the first i+1
+};
+
+//======================================================
+/** Overlaps through a nested containment list (see NCList) */
+template<class IntervalType>
+class NCListIndex: public SortedIntervalIndex<IntervalType>
+{
+public:
+  NCListIndex(): ncList() {}
+
+  void build(const svec<IntervalType*>& sorted) {
+    SortedIntervalIndex<IntervalType>::build(sorted);
+    ncList.constructSublists(sorted);
+  }
+
+  int getAnyOverlapping(int start, int stop, svec<IntervalType*>& results) const {
+    return ncList.getAnyOverlappingOnChrom(start, stop, results);
+  }
+
+private:
+  NCList<IntervalType> ncList;
+};
+
+#endif //_INTERVAL_INDEX_H_
@@ -0,0 +1,110 @@
+#ifndef _INTERVAL_TREE_H_
+#define _INTERVAL_TREE_H_
+
+#include "IntervalIndex.h"
+
+//======================================================
+/**
+ * Implicit augmented interval tree: the items sorted by start form a complete
+ * binary search tree laid out in the array itself (in-order), node i being on
+ * level k if its k lowest bits are set. Each node additionally holds the
+ * largest stop in its subtree, so whole subtrees ending before a query are
+ * skipped. Unlike a nested containment list, long intervals spanning many
+ * others cost nothing extra. Overlaps come out in order of their starts.
+ * Layout and traversal follow cgranges (Li H, https://github.com/lh3/cgranges).
+ */
+template<class IntervalType>
+class ImplicitIntervalTree: public SortedIntervalIndex<IntervalType>
+{
+public:
+  ImplicitIntervalTree(): maxStop(), maxLevel(-1) {}
+
+  void build(const svec<IntervalType*>& sorted);
+  int getAnyOverlapping(int start, int stop, svec<IntervalType*>& results) const;
+
+private:
+  /** Node on the traversal stack, left tells whether its left subtree is done */
+  struct TreeFrame {
+    int level;
+    int64_t node;
+    bool left;
+  };
+
+  svec<int32_t> maxStop;   /// Largest stop in the subtree of each node
+  int maxLevel;            /// Level of the root, -1 if empty
+};
+
+//======================================================
+template<class IntervalType>
+void ImplicitIntervalTree<IntervalType>::build(const svec<IntervalType*>& sorted)
+{
+  SortedIntervalIndex<IntervalType>::build(sorted);
+  const svec<int32_t>& stops = this->stops;
+  int64_t n = stops.isize();
+  maxStop.resize(n);
+  maxLevel = -1;
+  if(n == 0) { return; }
+
+  // Leaves, last being the largest stop of the subtree holding the last node
+  int64_t lastNode = 0;
+  int32_t last = 0;
+  int64_t i;
+  for(i=0; i<n; i+=2) {
+    lastNode = i;
+    last = maxStop[i] = stops[i];
+  }
+  int k;
+  for(k=1; (int64_t(1) << k) <= n; k++) {
+    int64_t x = int64_t(1) << (k-1);
+    for(i=(x << 1) - 1; i<n; i+=(x << 2)) {
+      int32_t left  = maxStop[i - x];
+      int32_t right = (i + x < n ? maxStop[i + x] : last);  // Missing right subtrees take the last node's
+      maxStop[i] = std::max(stops[i], std::max(left, right));
+    }
+    lastNode = ((lastNode >> k) & 1 ? lastNode - x : lastNode + x);  // Parent of the previous one
+    if(lastNode < n && maxStop[lastNode] > last) { last = maxStop[lastNode]; }
+  }
+  maxLevel = k - 1;
+}
+
+template<class IntervalType>
+int ImplicitIntervalTree<IntervalType>::getAnyOverlapping(int start, int stop, svec<IntervalType*>& results) const
+{
+  if(maxLevel < 0) { return results.isize(); }
+  const svec<int32_t>& starts = this->starts;
+  const svec<int32_t>& stops  = this->stops;
+  int64_t n = starts.isize();
+  TreeFrame stack[64];
+  int top = 0;
+  stack[top].level = maxLevel;
+  stack[top].node  = (int64_t(1) << maxLevel) - 1;
+  stack[top++].left = false;
+  while(top > 0) {
+    TreeFrame z = stack[--top];
+    if(z.level <= 3) {  // Small subtrees are scanned
+      int64_t i  = z.node >> z.level << z.level;
+      int64_t i1 = std::min(n, i + (int64_t(1) << (z.level + 1)) - 1);
+      for(; i<i1 && starts[i] <= stop; i++) {
+        if(stops[i] >= start) { results.push_back(this->items[i]); }
+      }
+    } else if(!z.left) {
+      int64_t y = z.node - (int64_t(1) << (z.level - 1));
+      stack[top].level = z.level;  // Back to the node once its left subtree is done
+      stack[top].node  = z.node;
+      stack[top++].left = true;
+      if(y >= n || maxStop[y] >= start) {
+        stack[top].level = z.level - 1;
+        stack[top].node  = y;
+        stack[top++].left = false;
+      }
+    } else if(z.node < n && starts[z.node] <= stop) {
+      if(stops[z.node] >= start) { results.push_back(this->items[z.node]); }
+      stack[top].level = z.level - 1;
+      stack[top].node  = z.node + (int64_t(1) << (z.level - 1));
+      stack[top++].left = false;
+    }
+  }
+  return results.isize();
+}
+
+#endif //_INTERVAL_TREE_H_
@@ -0,0 +1,101 @@
+#ifndef _ITEM_ARENA_H_
+#define _ITEM_ARENA_H_
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "ryggrad/src/base/SVector.h"
+
+//======================================================
+/**
+ * Typed arena owning objects of one type: they are constructed in place in
+ * large blocks, one after the other, and destroyed all at once by clear (or
+ * the destructor). Objects never move once added, so pointers to them stay
+ * valid until the arena is cleared. Adding objects in a given order lays them
+ * out contiguously in that order.
+ */
+template<class ItemType>
+class ItemArena
+{
+public:
+  ItemArena(): blocks(), count(0) {}
+  ~ItemArena() { clear(); }
+
+  ItemArena(const ItemArena&) = delete;
+  ItemArena& operator=(const ItemArena&) = delete;
+
+  int isize() const { return count; }
+
+  /** Makes sure the next n objects go into one block */
+  void reserve(int n) {
+    if(n <= 0) { return; }
+    if(blocks.empty() || blocks.back().capacity - blocks.back().used < n) { addBlock(n); }
+  }
+
+  /** Constructs a copy (or a moved instance) of item in the arena and returns it */
+  template<class Arg>
+  ItemType* add(Arg&& item) {
+    reserve(1);
+    Block& b = blocks.back();
+    ItemType* added = new (&b.slots[b.used]) ItemType(std::forward<Arg>(item));
+    b.used++;
+    count++;
+    return added;
+  }
+
+  /** Index of item in the order the objects were added, -1 if it is not in the arena */
+  int indexOf(const ItemType* item) const {
+    const Slot* slot = reinterpret_cast<const Slot*>(item);
+    std::less<const Slot*> before;
+    int first = 0;
+    for(int i=0; i<blocks.isize(); i++) {
+      const Slot* begin = blocks[i].slots.get();
+      if(!before(slot, begin) && before(slot, begin + blocks[i].used)) { return first + (int)(slot - begin); }
+      first += blocks[i].used;
+    }
+    return -1;
+  }
+
+  /** Destroys all the objects and releases the blocks */
+  void clear() {
+    for(int i=0; i<blocks.isize(); i++) {
+      for(int k=0; k<blocks[i].used; k++) {
+        reinterpret_cast<ItemType*>(&blocks[i].slots[k])->~ItemType();
+      }
+    }
+    blocks.clear();
+    count = 0;
+  }
+
+  void swap(ItemArena& other) {
+    blocks.swap(other.blocks);
+    std::swap(count, other.count);
+  }
+
+private:
+  typedef typename std::aligned_storage<sizeof(ItemType), alignof(ItemType)>::type Slot;
+
+  struct Block {
+    std::unique_ptr<Slot[]> slots;
+    int capacity;
+    int used;
+  };
+
+  /** New block for at least n objects, blocks growing with the arena to keep their number low */
+  void addBlock(int n) {
+    const int MIN_BLOCK = 1024;
+    Block b;
+    b.capacity = std::max(n, std::max(MIN_BLOCK, count));
+    b.slots.reset(new Slot[b.capacity]);
+    b.used = 0;
+    blocks.push_back(std::move(b));
+  }
+
+  svec<Block> blocks;
+  int count;           /// Objects in all blocks
+};
+
+#endif //_ITEM_ARENA_H_
@@ -1,179 +1,216 @@
 #ifndef _NC_LIST_H_
 #define _NC_LIST_H_
 
+#include <stdint.h>
 #include <string>
-#include <list>
 #include "ryggrad/src/base/SVector.h"
 
-//======================================================
-/** 
-  * Each sublist contains a set of contiguous intervals.
-  */
-template<class IntervalType>
-class Sublist
-{
-public:
-  Sublist(): intervals() {}
-  /** ctor1 used for initial memory allocation */
-  Sublist(int initRes): intervals() { reserve(initRes); }
-
-  ~Sublist() {}
-
-  /** Add a new interval to the list */
-  void addInterval(IntervalType* i) {
-    intervals.push_back(i);
-  }
-
-  /** Reserve memory for the interval vector */
-  void reserve(int numOfItems) { intervals.reserve(numOfItems); }
-
-  /** Checks to see if the latest interval contains the given interval */
-  bool contains(const IntervalType& other) const {
-    if(intervals.size()>0) { return intervals.back()->contains(other); }
-    else { return false; }
-  }
-  
- /** Use to check if the latest interval has an associated sublist */
- bool hasSublist() const {
-    if(intervals.size()>0) { return intervals.back()->hasSublist(); }
-    else { return false; }
- }
-   
- /** Use to get the associated sublist of the latest interval if it has one */
- int getSublist() const {
-    if(intervals.size()>0) { return intervals.back()->getSublist(); }
-    else { return -1; }
- }
- 
- /** Use to set the given sublist index for the latest interval */
- void setSublist(int sIndex) {
-    if(intervals.size()>0) { intervals.back()->setSublist(sIndex); }
- }
-
- /** Get all the intervals in the list that have any overlap with the given subject */
- int getAnyOverlaps(IntervalType* subject, svec<IntervalType*>& results) const; 
-   
-private:
-  svec<IntervalType*> intervals;
-};
-
-
-
 //======================================================
 /** NCList - Nested Containment Lists
  * Based on http://bioinformatics.oxfordjournals.org/content/23/11/1386
+ *
+ * The list owns its whole structure: the intervals are kept as packed records
+ * (chromosome id, start, stop, child range, item pointer) in one flat array,
+ * each sublist being a contiguous range of it with the top level list first.
+ * The indexed items are never modified, so any number of lists can be built
+ * over the same items, and queries only touch the packed integers.
  */
 template<class IntervalType>
 class NCList {
 public:
-  NCList():sublists() {}
+  NCList(): chroms(), records(), topCount(0) {}
 
-  void clear() { sublists.clear(); }
+  void clear() {
+    chroms.clear();
+    records.clear();
+    topCount = 0;
+  }
 
-  /** Given a vector of IntervalType items, this function constructs the relevant sublists 
-   *  Note that you should make sure that the sublists in the input IntervalType objects are all unset. 
- TODO decouple sublists from underlying input ds by adding them into the NCList class instead.
-   */
-  void constructSublists(const svec<IntervalType*>& input); 
-  int getAnyOverlapping(IntervalType* subject, svec<IntervalType*>& results) const; 
+  /** Given a vector of IntervalType items sorted by their coordinates, this function constructs the relevant sublists */
+  void constructSublists(const svec<IntervalType*>& input);
+  int getAnyOverlapping(IntervalType* subject, svec<IntervalType*>& results) const;
+  /** Same as above with the subject given by its coordinates */
+  int getAnyOverlapping(const string& chr, int start, int stop, svec<IntervalType*>& results) const;
+  /** Same as above for a list over the items of a single chromosome, which is then not looked up */
+  int getAnyOverlappingOnChrom(int start, int stop, svec<IntervalType*>& results) const {
+    if(chroms.isize() == 1) { getOverlapsFromSublist(0, start, stop, results); }
+    return results.isize();
+  }
 
 private:
-  /** Recursion for finding all overlaps in the nested containment lists */
-  void getOverlapsFromSublist(IntervalType* subject, int sublistIndex, svec<IntervalType*>& results) const;
-
-  /** 
-   * Adds a new sublist to the records (i.e sublists vector) containing the given interval.
-   * initRes tells the function how much initial memory to reserve in terms of number of items
-   * Returns the index to the added sublist item in the sublists vector
-   * so that it can be used for links to transcripts
+  /** One interval of a sublist, its nested intervals being records [childBegin, childEnd) */
+  struct Record {
+    int32_t chrom;       /// Index into chroms
+    int32_t start;
+    int32_t stop;
+    int32_t childBegin;
+    int32_t childEnd;
+    IntervalType* item;
+
+    bool hasOverlap(int32_t c, int32_t s, int32_t e) const { return (chrom == c && start <= e && s <= stop); }
+  };
+
+  /**
+   * Position of a query in one sublist: the scan goes forward from the lower bound and
+   * then backward from just before it
    */
-  int addNewSublist(IntervalType* interval, int initRes);
-
-  svec< Sublist<IntervalType> > sublists; /// Container for holding all the nested sublists
+  struct QueryFrame {
+    int begin;      /// First record of the sublist
+    int end;        /// Record after the last one of the sublist
+    int lBound;
+    int next;       /// Next record to test
+    bool forward;
+  };
+
+  /** Index of the chromosome in chroms, -1 if no interval lies on it */
+  int chromId(const string& chr) const;
+  /** First record of [begin, end) not ordered before the given coordinates (chromosome, start, stop) */
+  int lowerBound(int begin, int end, int32_t chrom, int32_t start, int32_t stop) const;
+  /** Walks the nested sublists depth first, appending the overlaps straight to results */
+  void getOverlapsFromSublist(int32_t chrom, int32_t start, int32_t stop, svec<IntervalType*>& results) const;
+
+  svec<string> chroms;    /// Sorted names of the chromosomes of the intervals
+  svec<Record> records;   /// All sublists, each one contiguous
+  int topCount;           /// Number of records in the top level sublist
 };
 
 
 //======================================================
 template<class IntervalType>
-int Sublist<IntervalType>::getAnyOverlaps(IntervalType* subject, svec<IntervalType*>& results) const {
-  typename svec<IntervalType*>::const_iterator lBound = lower_bound(intervals.begin(), intervals.end(),
-                                                                subject, IntervalType());
-  // Scan forward from the lBound to find the overlapping items 
-  for(typename svec<IntervalType*>::const_iterator it = lBound; it != intervals.end() ; ++it) {
-    if(subject->getCoords().hasOverlap((*it)->getCoords())) { results.push_back(*it); }
-    else { break; } // Gone beyond any possible overlap
-  }
-  // Scan backward from the lBound to find the overlapping items
-  typename svec<IntervalType*>::const_reverse_iterator rit(lBound);
-  for(; rit != intervals.rend() ; ++rit) {
-    if(subject->getCoords().hasOverlap((*rit)->getCoords())) { results.push_back(*rit); }
-    else { break; } // Gone beyond any possible overlap
-  }
-  return results.isize();   
-}
-   
-
-//======================================================
-template<class IntervalType>
-void NCList<IntervalType>::constructSublists(const svec<IntervalType*>& input) 
-{ 
+void NCList<IntervalType>::constructSublists(const svec<IntervalType*>& input)
+{
+  clear();                           // Make sure sublists don't exist from a previous creation
   if(input.empty()) { return; }
-  sublists.clear();                  // Make sure sublists don't exist from a previous creation 
-  sublists.reserve(input.isize()/2); // Rough estimate to avoid fragmented memory allocation
-  std::list<int> stack;              // Depth first stack for setting up the sublists
-  typename svec<IntervalType*>::const_iterator it = input.begin();
-  int slIndex = addNewSublist(*it, input.isize()/2);
-  stack.push_front(slIndex);
-  for(it = it + 1; it != input.end() ; ++it) {
+  int n = input.isize();
+
+  // Sublists as positions in input, the sublist nested in an interval being child[position]
+  svec< svec<int> > sublists;
+  svec<int> child;
+  child.resize(n, -1);
+  sublists.reserve(n/2);             // Rough estimate to avoid fragmented memory allocation
+  sublists.push_back(svec<int>());
+  sublists[0].reserve(n/2);
+  sublists[0].push_back(0);
+  svec<int> stack;                   // Depth first stack for setting up the sublists, top at the back
+  stack.push_back(0);
+  for(int i=1; i<n; i++) {
     while(!stack.empty()) {
-      if(sublists[stack.front()].contains(**it)) {
-        if(sublists[stack.front()].hasSublist()) {
-          sublists[sublists[stack.front()].getSublist()].addInterval(*it);
-          stack.push_front(sublists[stack.front()].getSublist()); 
-        } else { 
-          int slIndex = addNewSublist(*it, 100); 
-          sublists[stack.front()].setSublist(slIndex);
-          stack.push_front(slIndex);
-        } 
+      int last = sublists[stack.back()].back();
+      if(input[last]->contains(*input[i])) {
+        if(child[last] == -1) {
+          child[last] = sublists.isize();
+          sublists.push_back(svec<int>());
+        }
+        sublists[child[last]].push_back(i);
+        stack.push_back(child[last]);
         break;
       } else {
-        stack.pop_front();
+        stack.pop_back();
         if(stack.empty()) {// the item belongs to the top level sublist
-          sublists[0].addInterval(*it);
-          stack.push_front(0);
+          sublists[0].push_back(i);
+          stack.push_back(0);
           break;
-        } 
+        }
       }
     }
   }
+
+  for(int i=0; i<n; i++) { chroms.push_back(input[i]->getCoords().getChr()); }
+  UniqueSort(chroms);
+
+  // Lay the sublists out one after the other in order of creation
+  svec<int> offset;
+  offset.resize(sublists.isize() + 1, 0);
+  for(int s=0; s<sublists.isize(); s++) { offset[s+1] = offset[s] + sublists[s].isize(); }
+  records.resize(n);
+  for(int s=0; s<sublists.isize(); s++) {
+    for(int k=0; k<sublists[s].isize(); k++) {
+      int i = sublists[s][k];
+      Record& r = records[offset[s] + k];
+      r.chrom = chromId(input[i]->getCoords().getChr());
+      r.start = input[i]->getCoords().getStart();
+      r.stop  = input[i]->getCoords().getStop();
+      r.childBegin = (child[i] == -1 ? 0 : offset[child[i]]);
+      r.childEnd   = (child[i] == -1 ? 0 : offset[child[i]+1]);
+      r.item  = input[i];
+    }
+  }
+  topCount = sublists[0].isize();
 }
 
 template<class IntervalType>
 int NCList<IntervalType>::getAnyOverlapping(IntervalType* subject, svec<IntervalType*>& results) const {
-  int sublistIndex = 0;
-  getOverlapsFromSublist(subject, sublistIndex, results);
+  return getAnyOverlapping(subject->getCoords().getChr(), subject->getCoords().getStart(),
+                           subject->getCoords().getStop(), results);
+}
+
+template<class IntervalType>
+int NCList<IntervalType>::getAnyOverlapping(const string& chr, int start, int stop, svec<IntervalType*>& results) const {
+  int chrom = chromId(chr);
+  if(chrom != -1) { getOverlapsFromSublist(chrom, start, stop, results); }
   return results.isize();
 }
 
 template<class IntervalType>
-void NCList<IntervalType>::getOverlapsFromSublist(IntervalType* subject, int sublistIndex, svec<IntervalType*>& results) const {
-  Sublist<IntervalType> slist = sublists[sublistIndex];
-  svec<IntervalType*> out;
-  slist.getAnyOverlaps(subject, out);
-  for(typename svec<IntervalType*>::iterator it = out.begin(); it != out.end() ; ++it) {
-    results.push_back(*it);
-    if((*it)->hasSublist()) { getOverlapsFromSublist(subject, (*it)->getSublist(), results); } // Recurse with the sublist
+int NCList<IntervalType>::chromId(const string& chr) const {
+  svec<string>::const_iterator it = lower_bound(chroms.begin(), chroms.end(), chr);
+  if(it == chroms.end() || *it != chr) { return -1; }
+  return (int)(it - chroms.begin());
+}
+
+template<class IntervalType>
+int NCList<IntervalType>::lowerBound(int begin, int end, int32_t chrom, int32_t start, int32_t stop) const {
+  while(begin < end) {
+    int mid = begin + (end - begin)/2;
+    const Record& r = records[mid];
+    if(r.chrom != chrom ? r.chrom < chrom : (r.start != start ? r.start < start : r.stop < stop)) { begin = mid + 1; }
+    else { end = mid; }
   }
-  return;
+  return begin;
 }
 
 template<class IntervalType>
-int NCList<IntervalType>::addNewSublist(IntervalType* interval, int initRes) { 
-  Sublist<IntervalType> sl(initRes);
-  sl.addInterval(interval);
-  sublists.push_back(sl);
-  int slIndex = (int) sublists.size() -1; //index of added sublist
-  return slIndex;
+void NCList<IntervalType>::getOverlapsFromSublist(int32_t chrom, int32_t start, int32_t stop, svec<IntervalType*>& results) const {
+  if(topCount == 0) { return; }
+  // Nesting is shallow in practice, so the stack only allocates for unusually deep lists
+  const int LOCAL_DEPTH = 64;
+  QueryFrame local[LOCAL_DEPTH];
+  svec<QueryFrame> deep;
+  int depth = 0;
+  auto frame = [&](int d) -> QueryFrame& { return (d < LOCAL_DEPTH ? local[d] : deep[d - LOCAL_DEPTH]); };
+  auto push  = [&](int begin, int end) {
+    if(depth >= LOCAL_DEPTH && deep.isize() <= depth - LOCAL_DEPTH) { deep.push_back(QueryFrame()); }
+    QueryFrame& f = frame(depth++);
+    f.begin   = begin;
+    f.end     = end;
+    f.lBound  = lowerBound(begin, end, chrom, start, stop);
+    f.next    = f.lBound;
+    f.forward = true;
+  };
+
+  push(0, topCount);
+  while(depth > 0) {
+    QueryFrame& f = frame(depth-1);
+    const Record* r = NULL;
+    if(f.forward) {
+      if(f.next < f.end && records[f.next].hasOverlap(chrom, start, stop)) {
+        r = &records[f.next++];
+      } else {  // Gone beyond any possible overlap
+        f.forward = false;
+        f.next    = f.lBound - 1;
+      }
+    }
+    if(!f.forward && r == NULL) {
+      if(f.next >= f.begin && records[f.next].hasOverlap(chrom, start, stop)) {
+        r = &records[f.next--];
+      } else {  // Done with this sublist
+        depth--;
+        continue;
+      }
+    }
+    results.push_back(r->item);
+    if(r->childBegin < r->childEnd) { push(r->childBegin, r->childEnd); } // Descend before going on with this sublist
+  }
 }
 
 #endif //_NC_LIST_H_
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <random>
+#include <string>
+#include "ryggrad/src/base/CommandLineParser.h"
+#include "IntervalIndex.h"
+#include "IntervalTree.h"
+
+// Checks both interval index backends against a brute-force scan on random intervals of one
+// chromosome: overlaps, contained items and nearest items, with short, long and nested intervals.
+
+//======================================================
+/** Bare interval with the members the indexes read */
+struct TestCoords
+{
+  const string& getChr() const { return chr;   }
+  int getStart() const         { return start; }
+  int getStop() const          { return stop;  }
+
+  string chr;
+  int start;
+  int stop;
+};
+
+struct TestInterval
+{
+  const TestCoords& getCoords() const { return coords; }
+  bool contains(const TestInterval& other) const {
+    return (coords.start <= other.coords.start && other.coords.stop <= coords.stop);
+  }
+
+  TestCoords coords;
+};
+
+// Distance between an interval and a query it does not overlap
+static long long Gap(const TestInterval* t, int start, int stop)
+{
+  return (t->coords.stop < start ? (long long)start - t->coords.stop : (long long)t->coords.start - stop);
+}
+
+static bool SameItems(svec<TestInterval*> a, svec<TestInterval*> b)
+{
+  sort(a.begin(), a.end());
+  sort(b.begin(), b.end());
+  return a == b;
+}
+
+// Runs the queries on one index, returns the number of failed checks
+static int CheckIndex(const IntervalIndex<TestInterval>& index, const char* name,
+                      const svec<TestInterval*>& sorted, int start, int stop)
+{
+  svec<TestInterval*> overlapping, contained;
+  for(int i=0; i<sorted.isize(); i++) {
+    const TestCoords& c = sorted[i]->coords;
+    if(c.start <= stop && start <= c.stop) { overlapping.push_back(sorted[i]); }
+    if(start <= c.start && c.stop <= stop) { contained.push_back(sorted[i]); }
+  }
+  int failures = 0;
+  svec<TestInterval*> results;
+  index.getAnyOverlapping(start, stop, results);
+  if(!SameItems(results, overlapping)) {
+    cout << name << ": " << results.isize() << " overlaps of " << start << "-" << stop << ", expected " << overlapping.isize() << endl;
+    failures++;
+  }
+  results.clear();
+  index.getContained(start, stop, results);
+  if(results != contained) {  // In order of their coordinates, as sorted is
+    cout << name << ": " << results.isize() << " items within " << start << "-" << stop << ", expected " << contained.isize() << endl;
+    failures++;
+  }
+  results.clear();
+  index.getNearest(start, stop, results);
+  if(!overlapping.empty()) {
+    if(!SameItems(results, overlapping)) {
+      cout << name << ": nearest items of " << start << "-" << stop << " are not its overlaps" << endl;
+      failures++;
+    }
+  } else if(!sorted.empty()) {
+    long long best = -1;
+    for(int i=0; i<sorted.isize(); i++) {
+      long long gap = Gap(sorted[i], start, stop);
+      if(best < 0 || gap < best) { best = gap; }
+    }
+    bool ok = (results.isize() >= 1 && results.isize() <= 2);
+    for(int i=0; ok && i<results.isize(); i++) { ok = (Gap(results[i], start, stop) == best); }
+    if(!ok) {
+      cout << name << ": nearest items of " << start << "-" << stop << " are not the closest ones" << endl;
+      failures++;
+    }
+  }
+  return failures;
+}
+
+int main(int argc,char** argv)
+{
+  commandArg<int> roundCmmd("-n", "Number of random interval sets", 300);
+  commandArg<int> queryCmmd("-q", "Number of queries per set", 200);
+  commandArg<int> seedCmmd("-s", "Random seed", 1);
+  commandLineParser P(argc,argv);
+  P.SetDescription("Checks the NCList and interval tree indexes against a brute-force scan.");
+  P.registerArg(roundCmmd);
+  P.registerArg(queryCmmd);
+  P.registerArg(seedCmmd);
+  P.parse();
+  int rounds  = P.GetIntValueFor(roundCmmd);
+  int queries = P.GetIntValueFor(queryCmmd);
+  int seed    = P.GetIntValueFor(seedCmmd);
+
+  std::mt19937 rng(seed);
+  int failures = 0;
+  for(int r=0; r<rounds; r++) {
+    // Mostly exon sized intervals, some long ones spanning many others, some sets empty
+    int n = rng() % 700;
+    svec<TestInterval> intervals;
+    intervals.resize(n);
+    for(int i=0; i<n; i++) {
+      TestCoords& c = intervals[i].coords;
+      c.chr   = "chr1";
+      c.start = rng() % 5000;
+      c.stop  = c.start + (rng() % 10 == 0 ? rng() % 2000 : rng() % 60);
+    }
+    // Sorted by start, containing intervals first, as the annotation hands them to the indexes
+    svec<TestInterval*> sorted;
+    for(int i=0; i<n; i++) { sorted.push_back(&intervals[i]); }
+    sort(sorted.begin(), sorted.end(), [](const TestInterval* a, const TestInterval* b) {
+      return (a->coords.start != b->coords.start ? a->coords.start < b->coords.start : a->coords.stop > b->coords.stop);
+    });
+
+    NCListIndex<TestInterval> ncList;
+    ImplicitIntervalTree<TestInterval> tree;
+    ncList.build(sorted);
+    tree.build(sorted);
+    for(int q=0; q<queries; q++) {
+      int start = (int)(rng() % 5500) - 100;
+      int stop  = start + rng() % (rng() % 5 == 0 ? 1000 : 100);
+      failures += CheckIndex(ncList, "NCList", sorted, start, stop);
+      failures += CheckIndex(tree, "Interval tree", sorted, start, stop);
+    }
+  }
+
+  if(failures > 0) {
+    cout << failures << " checks failed" << endl;
+    return 1;
+  }
+  cout << "All checks passed" << endl;
+  return 0;
+}
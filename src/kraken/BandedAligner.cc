@@ -0,0 +1,289 @@
+#ifndef FORCE_DEBUG
+#define NDEBUG
+#endif
+
+#include <algorithm>
+#include <string.h>
+#include "ryggrad/src/base/Logger.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BANDED_X86
+#endif
+#include "BandedAligner.h"
+
+// Score of cells outside the band or the matrix for the gap states, low enough never to win
+static const int32_t NEG_SCORE = -(1 << 29);
+
+/** Scoring and the anti-diagonals a kernel reads and writes, indexed by query position */
+struct DiagonalArgs
+{
+  const uint8_t * query;
+  const uint8_t * target;   /// Reversed target, cell (i, d-i) compares query[i] with target[targetOff+i]
+  int targetOff;
+  const int32_t * h2;       /// Anti-diagonal d-2
+  const int32_t * h1;       /// Anti-diagonal d-1
+  const int32_t * e1;
+  const int32_t * f1;
+  int32_t * h0;             /// Anti-diagonal d being computed
+  int32_t * e0;
+  int32_t * f0;
+  int32_t match;
+  int32_t mismatch;
+  int32_t gapOpen;
+  int32_t gapExtend;
+};
+
+// Computes cells lo..hi of the anti-diagonal, returns their maximum
+static int32_t DiagonalScalar(const DiagonalArgs & a, int lo, int hi)
+{
+  int32_t best = 0;
+  for (int i=lo; i<=hi; i++) {
+    int32_t s = (a.query[i] == a.target[a.targetOff + i]) ? a.match : a.mismatch;
+    int32_t e = std::max(a.h1[i] + a.gapOpen, a.e1[i] + a.gapExtend);
+    int32_t f = std::max(a.h1[i-1] + a.gapOpen, a.f1[i-1] + a.gapExtend);
+    int32_t h = std::max(std::max(0, a.h2[i-1] + s), std::max(e, f));
+    a.h0[i] = h;
+    a.e0[i] = e;
+    a.f0[i] = f;
+    best = std::max(best, h);
+  }
+  return best;
+}
+
+#ifdef BANDED_X86
+__attribute__((target("sse4.1")))
+static int32_t DiagonalSse41(const DiagonalArgs & a, int lo, int hi)
+{
+  const __m128i zero  = _mm_setzero_si128();
+  const __m128i mis   = _mm_set1_epi32(a.mismatch);
+  const __m128i delta = _mm_set1_epi32(a.match - a.mismatch);
+  const __m128i open  = _mm_set1_epi32(a.gapOpen);
+  const __m128i ext   = _mm_set1_epi32(a.gapExtend);
+  __m128i vbest = zero;
+  int i = lo;
+  for (; i+3<=hi; i+=4) {
+    int32_t qw, tw;
+    memcpy(&qw, a.query + i, 4);
+    memcpy(&tw, a.target + a.targetOff + i, 4);
+    __m128i eq = _mm_cmpeq_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(qw)),
+                                 _mm_cvtepu8_epi32(_mm_cvtsi32_si128(tw)));
+    __m128i s  = _mm_add_epi32(mis, _mm_and_si128(eq, delta));
+    __m128i h1 = _mm_loadu_si128((const __m128i*)(a.h1 + i));
+    __m128i h1l = _mm_loadu_si128((const __m128i*)(a.h1 + i - 1));
+    __m128i e = _mm_max_epi32(_mm_add_epi32(h1, open),
+                              _mm_add_epi32(_mm_loadu_si128((const __m128i*)(a.e1 + i)), ext));
+    __m128i f = _mm_max_epi32(_mm_add_epi32(h1l, open),
+                              _mm_add_epi32(_mm_loadu_si128((const __m128i*)(a.f1 + i - 1)), ext));
+    __m128i h = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(a.h2 + i - 1)), s);
+    h = _mm_max_epi32(_mm_max_epi32(h, zero), _mm_max_epi32(e, f));
+    _mm_storeu_si128((__m128i*)(a.h0 + i), h);
+    _mm_storeu_si128((__m128i*)(a.e0 + i), e);
+    _mm_storeu_si128((__m128i*)(a.f0 + i), f);
+    vbest = _mm_max_epi32(vbest, h);
+  }
+  vbest = _mm_max_epi32(vbest, _mm_shuffle_epi32(vbest, _MM_SHUFFLE(1, 0, 3, 2)));
+  vbest = _mm_max_epi32(vbest, _mm_shuffle_epi32(vbest, _MM_SHUFFLE(2, 3, 0, 1)));
+  int32_t best = _mm_cvtsi128_si32(vbest);
+  if (i <= hi)
+    best = std::max(best, DiagonalScalar(a, i, hi));
+  return best;
+}
+
+__attribute__((target("avx2")))
+static int32_t DiagonalAvx2(const DiagonalArgs & a, int lo, int hi)
+{
+  const __m256i zero  = _mm256_setzero_si256();
+  const __m256i mis   = _mm256_set1_epi32(a.mismatch);
+  const __m256i delta = _mm256_set1_epi32(a.match - a.mismatch);
+  const __m256i open  = _mm256_set1_epi32(a.gapOpen);
+  const __m256i ext   = _mm256_set1_epi32(a.gapExtend);
+  __m256i vbest = zero;
+  int i = lo;
+  for (; i+7<=hi; i+=8) {
+    __m256i eq = _mm256_cmpeq_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(a.query + i))),
+                                    _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(a.target + a.targetOff + i))));
+    __m256i s  = _mm256_add_epi32(mis, _mm256_and_si256(eq, delta));
+    __m256i h1 = _mm256_loadu_si256((const __m256i*)(a.h1 + i));
+    __m256i h1l = _mm256_loadu_si256((const __m256i*)(a.h1 + i - 1));
+    __m256i e = _mm256_max_epi32(_mm256_add_epi32(h1, open),
+                                 _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(a.e1 + i)), ext));
+    __m256i f = _mm256_max_epi32(_mm256_add_epi32(h1l, open),
+                                 _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(a.f1 + i - 1)), ext));
+    __m256i h = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(a.h2 + i - 1)), s);
+    h = _mm256_max_epi32(_mm256_max_epi32(h, zero), _mm256_max_epi32(e, f));
+    _mm256_storeu_si256((__m256i*)(a.h0 + i), h);
+    _mm256_storeu_si256((__m256i*)(a.e0 + i), e);
+    _mm256_storeu_si256((__m256i*)(a.f0 + i), f);
+    vbest = _mm256_max_epi32(vbest, h);
+  }
+  __m128i v = _mm_max_epi32(_mm256_castsi256_si128(vbest), _mm256_extracti128_si256(vbest, 1));
+  v = _mm_max_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_max_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  int32_t best = _mm_cvtsi128_si32(v);
+  if (i <= hi)
+    best = std::max(best, DiagonalScalar(a, i, hi));
+  return best;
+}
+#endif
+
+//======================================================
+BandedAligner::BandedAligner(int match, int mismatch, int gapOpen, int gapExtend)
+  : m_match(match), m_mismatch(mismatch), m_gapOpen(gapOpen), m_gapExtend(gapExtend),
+    m_kernel(BestKernel()), m_query(), m_target() {}
+
+static BandedAligner::Kernel DetectKernel()
+{
+  BandedAligner::Kernel kernel = BandedAligner::SCALAR;
+#ifdef BANDED_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    kernel = BandedAligner::AVX2;
+  else if (__builtin_cpu_supports("sse4.1"))
+    kernel = BandedAligner::SSE41;
+#endif
+  FILE_LOG(logINFO) << "Banded alignment kernel: " << BandedAligner::KernelName(kernel);
+  return kernel;
+}
+
+BandedAligner::Kernel BandedAligner::BestKernel()
+{
+  // Detected (and logged) once, when the first aligner is set up
+  static const Kernel kernel = DetectKernel();
+  return kernel;
+}
+
+const char * BandedAligner::KernelName(Kernel k)
+{
+  switch (k) {
+  case AVX2:  return "avx2";
+  case SSE41: return "sse4.1";
+  default:    return "scalar";
+  }
+}
+
+// A=0 C=1 G=2 T=3, anything else gets its own code per sequence so that it never matches
+static uint8_t BaseCode(char c, uint8_t other)
+{
+  switch (c) {
+  case 'A': case 'a': return 0;
+  case 'C': case 'c': return 1;
+  case 'G': case 'g': return 2;
+  case 'T': case 't': return 3;
+  default:            return other;
+  }
+}
+
+void BandedAligner::Encode(const DNAView & query, const DNAView & target)
+{
+  int m = query.isize();
+  int n = target.isize();
+  m_query.resize(m);
+  m_target.resize(n);
+  int i;
+  for (i=0; i<m; i++)
+    m_query[i] = BaseCode(query[i], 4);
+  for (i=0; i<n; i++)
+    m_target[n-1-i] = BaseCode(target[i], 5);
+}
+
+// x/2 rounded down and up, also for negative x
+static int FloorHalf(int x) { return (x >= 0 ? x/2 : -((1 - x)/2)); }
+static int CeilHalf(int x)  { return -FloorHalf(-x); }
+
+BandedScore BandedAligner::Align(const DNAView & query, const DNAView & target, int bound, bool findStart)
+{
+  if (bound < 0)
+    return BandedScore();
+  BandedScore result = AlignBand(query, target, -bound, bound);
+  if (!findStart || result.score == 0)
+    return result;
+
+  // The best alignment ending at the end found is the best one of the reversed prefixes ending 
+  // there, the band being shifted by the diagonal of the end. Complementing both sides keeps 
+  // which bases match, so reverse complemented views serve as the reversed prefixes.
+  int shift = result.targetEnd - result.queryEnd;
+  BandedScore back = AlignBand(query.Sub(0, result.queryEnd + 1).ReverseComplement(),
+                               target.Sub(0, result.targetEnd + 1).ReverseComplement(),
+                               shift - bound, shift + bound);
+  result.queryStart  = result.queryEnd - back.queryEnd;
+  result.targetStart = result.targetEnd - back.targetEnd;
+  return result;
+}
+
+BandedScore BandedAligner::AlignBand(const DNAView & query, const DNAView & target, int lowDiag, int highDiag)
+{
+  BandedScore result;
+  int m = query.isize();
+  int n = target.isize();
+  if (m == 0 || n == 0 || lowDiag > highDiag)
+    return result;
+  Encode(query, target);
+
+  // Slot 0 stands for query position -1, one more slot past the end for the band edge
+  int k;
+  for (k=0; k<3; k++) {
+    m_h[k].resize(m + 2);
+    std::fill(m_h[k].begin(), m_h[k].end(), 0);
+  }
+  for (k=0; k<2; k++) {
+    m_e[k].resize(m + 2);
+    m_f[k].resize(m + 2);
+    std::fill(m_e[k].begin(), m_e[k].end(), NEG_SCORE);
+    std::fill(m_f[k].begin(), m_f[k].end(), NEG_SCORE);
+  }
+
+  int32_t (*diagonal)(const DiagonalArgs &, int, int) = DiagonalScalar;
+#ifdef BANDED_X86
+  if (m_kernel == AVX2)
+    diagonal = DiagonalAvx2;
+  else if (m_kernel == SSE41)
+    diagonal = DiagonalSse41;
+#endif
+
+  DiagonalArgs a;
+  a.query     = &m_query[0];
+  a.target    = &m_target[0];
+  a.match     = m_match;
+  a.mismatch  = m_mismatch;
+  a.gapOpen   = m_gapOpen;
+  a.gapExtend = m_gapExtend;
+  for (int d=0; d<m+n-1; d++) {
+    // Cells (i, d-i) inside the matrix and the band
+    int lo = std::max(std::max(0, d-n+1), CeilHalf(d - highDiag));
+    int hi = std::min(std::min(m-1, d), FloorHalf(d - lowDiag));
+    if (lo > m)
+      break;  // The band has left the matrix for good
+
+    a.targetOff = n-1-d;
+    a.h2 = &m_h[(d+1) % 3][1];
+    a.h1 = &m_h[(d+2) % 3][1];
+    a.e1 = &m_e[(d+1) % 2][1];
+    a.f1 = &m_f[(d+1) % 2][1];
+    a.h0 = &m_h[d % 3][1];
+    a.e0 = &m_e[d % 2][1];
+    a.f0 = &m_f[d % 2][1];
+    // An anti-diagonal can be empty, e.g. every other one with a zero band
+    int32_t best = (lo <= hi ? diagonal(a, lo, hi) : 0);
+
+    // Cells next to the range are read as outside of the band by the next two anti-diagonals
+    // (if the band has not reached the matrix yet, hi is below lo and maybe below the slots)
+    if (lo - 1 <= m) {
+      a.h0[lo-1] = 0;
+      a.e0[lo-1] = a.f0[lo-1] = NEG_SCORE;
+    }
+    if (hi + 1 >= -1) {
+      a.h0[hi+1] = 0;
+      a.e0[hi+1] = a.f0[hi+1] = NEG_SCORE;
+    }
+
+    if (best > result.score) {
+      int i = lo;
+      while (a.h0[i] != best)
+        i++;
+      result.score     = best;
+      result.queryEnd  = i;
+      result.targetEnd = d - i;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,79 @@
+#ifndef _BANDEDALIGNER_H_
+#define _BANDEDALIGNER_H_
+
+#include <stdint.h>
+#include "ryggrad/src/base/SVector.h"
+#include "ryggrad/src/general/DNAVector.h"
+#include "DNAView.h"
+
+//======================================================
+/** Best banded local alignment, given by its score and the first and last aligned bases of either side */
+struct BandedScore
+{
+  BandedScore(): score(0), queryStart(-1), queryEnd(-1), targetStart(-1), targetEnd(-1) {}
+
+  /** Number of query bases from the first to the last aligned one */
+  int QueryAligned() const  { return (score > 0 ? queryEnd - queryStart + 1 : 0);   }
+  /** Number of target bases from the first to the last aligned one */
+  int TargetAligned() const { return (score > 0 ? targetEnd - targetStart + 1 : 0); }
+
+  int score;        /// Best local alignment score, 0 if nothing aligns
+  int queryStart;   /// First aligned query base, -1 if score is 0 or the start was not asked for
+  int queryEnd;     /// Last aligned query base, -1 if score is 0
+  int targetStart;  /// First aligned target base, -1 if score is 0 or the start was not asked for
+  int targetEnd;    /// Last aligned target base, -1 if score is 0
+};
+
+//======================================================
+/**
+ * Linear memory banded Smith-Waterman with affine gaps, restricted to the cells
+ * with |targetPos - queryPos| <= bound. A gap of length L scores
+ * gapOpen + (L-1)*gapExtend; bases other than ACGT never match. There is no
+ * traceback: the end of the best alignment comes out of the forward pass and
+ * its start out of a second pass over the reverse complemented prefixes
+ * ending there, which has the same scores read backwards.
+ *
+ * The matrix is filled by anti-diagonals, whose cells are independent of each
+ * other, so that each anti-diagonal is one vectorised pass. The SSE4.1 or AVX2
+ * kernel is picked at runtime from the CPU features, with a scalar fallback;
+ * all kernels give identical results. The object keeps its scratch buffers,
+ * hence one aligner per thread (e.g. the one in MapperContext).
+ */
+class BandedAligner
+{
+public:
+  enum Kernel { SCALAR, SSE41, AVX2 };
+
+  BandedAligner(int match=1, int mismatch=-1, int gapOpen=-5, int gapExtend=-2);
+
+  /** Best kernel the CPU supports */
+  static Kernel BestKernel();
+  static const char * KernelName(Kernel k);
+
+  Kernel GetKernel() const    { return m_kernel; }
+  void   SetKernel(Kernel k)  { m_kernel = k;    }
+
+  /**
+   * Takes views so that sub-sequences and reverse strands are aligned without copying them first.
+   * The start of the alignment is only searched for if findStart is set, the score and end do not need it.
+   */
+  BandedScore Align(const DNAView & query, const DNAView & target, int bound, bool findStart = true);
+
+private:
+  void Encode(const DNAView & query, const DNAView & target);
+  /** Best cell among those with lowDiag <= targetPos - queryPos <= highDiag */
+  BandedScore AlignBand(const DNAView & query, const DNAView & target, int lowDiag, int highDiag);
+
+  int m_match;
+  int m_mismatch;
+  int m_gapOpen;
+  int m_gapExtend;
+  Kernel m_kernel;           /// Kernel used by Align
+  svec<uint8_t> m_query;     /// Encoded query
+  svec<uint8_t> m_target;    /// Encoded target, reversed so that anti-diagonals read it forwards
+  svec<int32_t> m_h[3];      /// Scores of the last three anti-diagonals, indexed by query position + 1
+  svec<int32_t> m_e[2];      /// Gap-in-query scores of the last two anti-diagonals
+  svec<int32_t> m_f[2];      /// Gap-in-target scores of the last two anti-diagonals
+};
+
+#endif //_BANDEDALIGNER_H_
@@ -0,0 +1,149 @@
+#include <chrono>
+#include <string>
+#include "ryggrad/src/base/CommandLineParser.h"
+#include "ryggrad/src/base/Logger.h"
+#include "../annotationQuery/AnnotationQuery.h"
+#include "KrakenConfig.h"
+#include "KrakenMap.h"
+
+// Throughput and accuracy of the adaptive destination windows (-A) against the fixed ones: the
+// annotation items are mapped in either mode and the adaptive results compared with the fixed
+// ones, which serve as the reference. A lookup longer than the largest cross-correlation block
+// is mapped in either mode as well, adaptive blocks not fitting it fall back to the fixed ones.
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Maps all lookups the way TransAnnotation::translateCoordinates does, on one thread
+static double MapAll(Kraken & mapper, const svec<Coordinate> & lookups, int source, int target,
+                     svec<Coordinate> & results, svec<int> & found)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  MapperContext ctx;
+  svec< svec<Coordinate> > candidates;
+  mapper.MapItemBatch(lookups, source, target, candidates);
+  results.clear();
+  results.resize(lookups.isize());
+  found.clear();
+  found.resize(lookups.isize(), 0);
+  for (int i=0; i<lookups.isize(); i++)
+    found[i] = mapper.RefineItem(lookups[i], source, target, candidates[i], results[i], ctx);
+  return Seconds(start);
+}
+
+int main(int argc,char** argv)
+{
+  commandArg<string> configCmmd("-c", "Configuration file (e.g. sample/dere_dyak_dmel.config, run from its directory)");
+  commandArg<string> gtfCmmd("-s", "Source GTF file");
+  commandArg<string> sourceCmmd("-S", "Source genome id");
+  commandArg<string> targetCmmd("-T", "Target genome id");
+  commandArg<int>    repeatCmmd("-n", "Number of timed runs per mode, the best one is reported", 3);
+  commandArg<int>    longCmmd("-L", "Length of the long lookup, from the start of the first item's chromosome (0: off)", 170000);
+  commandLineParser P(argc,argv);
+  P.SetDescription("Times mapping an annotation with fixed and with adaptive destination windows and compares the results.");
+  P.registerArg(configCmmd);
+  P.registerArg(gtfCmmd);
+  P.registerArg(sourceCmmd);
+  P.registerArg(targetCmmd);
+  P.registerArg(repeatCmmd);
+  P.registerArg(longCmmd);
+  P.parse();
+  string configFile = P.GetStringValueFor(configCmmd);
+  string gtfFile    = P.GetStringValueFor(gtfCmmd);
+  string sourceName = P.GetStringValueFor(sourceCmmd);
+  string targetName = P.GetStringValueFor(targetCmmd);
+  int    repeats    = max(1, P.GetIntValueFor(repeatCmmd));
+  int    longLength = P.GetIntValueFor(longCmmd);
+  FILELog::ReportingLevel() = logWARNING;
+
+  Kraken mapper;
+  KrakenConfig config(&mapper);
+  if (!config.Configure(configFile)) {
+    cout << "Could not read the configuration " << configFile << endl;
+    return 1;
+  }
+  int source = mapper.GenomeId(sourceName);
+  int target = mapper.GenomeId(targetName);
+  if (source < 0 || target < 0) {
+    cout << "Unknown genome " << (source < 0 ? sourceName : targetName) << endl;
+    return 1;
+  }
+  Annotation annot(gtfFile, sourceName);
+  const svec<AnnotItemBase*> & items = annot.getDataByCoord(AITEM);
+  svec<Coordinate> lookups;
+  lookups.resize(items.isize());
+  for (int i=0; i<items.isize(); i++)
+    lookups[i] = items[i]->getCoords();
+
+  // One untimed run loads the genomes and maps, then the modes take turns
+  svec<Coordinate> fixed, adaptive;
+  svec<int> fixedFound, adaptiveFound;
+  mapper.setAdaptiveWindow(false);
+  MapAll(mapper, lookups, source, target, fixed, fixedFound);
+  double fixedTime = 0, adaptiveTime = 0;
+  for (int r=0; r<repeats; r++) {
+    mapper.setAdaptiveWindow(false);
+    double t = MapAll(mapper, lookups, source, target, fixed, fixedFound);
+    fixedTime = (r == 0 ? t : min(fixedTime, t));
+    mapper.setAdaptiveWindow(true);
+    t = MapAll(mapper, lookups, source, target, adaptive, adaptiveFound);
+    adaptiveTime = (r == 0 ? t : min(adaptiveTime, t));
+  }
+
+  int fixedMapped = 0, adaptiveMapped = 0, same = 0, overlapping = 0, onlyFixed = 0, onlyAdaptive = 0;
+  for (int i=0; i<lookups.isize(); i++) {
+    fixedMapped    += (fixedFound[i] ? 1 : 0);
+    adaptiveMapped += (adaptiveFound[i] ? 1 : 0);
+    if (fixedFound[i] && adaptiveFound[i]) {
+      const Coordinate & f = fixed[i];
+      const Coordinate & a = adaptive[i];
+      bool sameRegion = (f.getChr() == a.getChr() && f.isReversed() == a.isReversed());
+      if (sameRegion && f.getStart() == a.getStart() && f.getStop() == a.getStop())
+        same++;
+      else if (sameRegion && f.getStart() <= a.getStop() && a.getStart() <= f.getStop())
+        overlapping++;
+    } else if (fixedFound[i]) {
+      onlyFixed++;
+    } else if (adaptiveFound[i]) {
+      onlyAdaptive++;
+    }
+  }
+
+  // The long lookup, which needs several blocks of the destination window whatever the mode
+  bool longFixed = false, longAdaptive = false;
+  double longFixedTime = 0, longAdaptiveTime = 0;
+  Coordinate longLookup, longFixedResult, longAdaptiveResult;
+  if (longLength > 0 && lookups.isize() > 0) {
+    const string & chr = lookups[0].getChr();
+    int chrSize = mapper.GetGenomes()[source].ChromosomeSize(chr);
+    longLookup.set(chr, true, 0, min(longLength, chrSize) - 1);
+    MapperContext ctx;
+    mapper.setAdaptiveWindow(false);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    longFixed = mapper.Find(longLookup, source, target, longFixedResult, ctx);
+    longFixedTime = Seconds(start);
+    mapper.setAdaptiveWindow(true);
+    start = std::chrono::steady_clock::now();
+    longAdaptive = mapper.Find(longLookup, source, target, longAdaptiveResult, ctx);
+    longAdaptiveTime = Seconds(start);
+  }
+
+  int n = max(1, lookups.isize());
+  cout << "Items: " << lookups.isize() << " (" << sourceName << " -> " << targetName << ")" << endl;
+  cout << "Fixed windows:    " << fixedTime << " s (" << 1e3 * fixedTime / n << " ms per item), "
+       << fixedMapped << " mapped" << endl;
+  cout << "Adaptive windows: " << adaptiveTime << " s (" << 1e3 * adaptiveTime / n << " ms per item), "
+       << adaptiveMapped << " mapped" << endl;
+  cout << "Adaptive vs fixed: " << same << " identical, " << overlapping << " overlapping, "
+       << fixedMapped - same - overlapping - onlyFixed << " elsewhere, " << onlyFixed << " only mapped with fixed, "
+       << onlyAdaptive << " only mapped with adaptive windows" << endl;
+  if (longLength > 0 && lookups.isize() > 0) {
+    cout << "Long lookup " << longLookup.toString('\t') << ": fixed " << longFixedTime << " s ("
+         << (longFixed ? longFixedResult.toString('\t') : string("not mapped")) << "), adaptive " 
+         << longAdaptiveTime << " s (" << (longAdaptive ? longAdaptiveResult.toString('\t') : string("not mapped")) 
+         << ")" << endl;
+  }
+  return 0;
+}
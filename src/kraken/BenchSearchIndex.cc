@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include "ryggrad/src/base/CommandLineParser.h"
+#include "SearchIndex.h"
+
+// Microbenchmark of the synteny block search: EytzingerIndex::LowerBound against
+// std::lower_bound over the same sorted starts, with the results checked to agree.
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc,char** argv)
+{
+  commandArg<int> sizeCmmd("-n", "Number of sorted values (e.g. block starts of one chromosome)", 1000000);
+  commandArg<int> queryCmmd("-q", "Number of lookups", 10000000);
+  commandArg<int> seedCmmd("-s", "Random seed", 1);
+  commandLineParser P(argc,argv);
+  P.SetDescription("Times lower bound searches through an Eytzinger index and a binary search over the same sorted values.");
+  P.registerArg(sizeCmmd);
+  P.registerArg(queryCmmd);
+  P.registerArg(seedCmmd);
+  P.parse();
+  int n       = P.GetIntValueFor(sizeCmmd);
+  int queries = P.GetIntValueFor(queryCmmd);
+  int seed    = P.GetIntValueFor(seedCmmd);
+
+  // Starts spread like synteny blocks along a chromosome, with some repeats
+  std::mt19937 rng(seed);
+  svec<int32_t> sorted;
+  sorted.resize(n);
+  int32_t pos = 0;
+  for (int i=0; i<n; i++) {
+    pos += rng() % 200;
+    sorted[i] = pos;
+  }
+  svec<int32_t> lookups;
+  lookups.resize(queries);
+  for (int i=0; i<queries; i++)
+    lookups[i] = (int32_t)(rng() % ((uint32_t)pos + 100));
+
+  EytzingerIndex index;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  index.Build(sorted.empty() ? NULL : &sorted[0], n);
+  double buildTime = Seconds(start);
+
+  // The sums keep the searches from being optimised away and double as the check
+  const int32_t * begin = sorted.empty() ? NULL : &sorted[0];
+  long long binarySum = 0;
+  start = std::chrono::steady_clock::now();
+  for (int i=0; i<queries; i++)
+    binarySum += std::lower_bound(begin, begin + n, lookups[i]) - begin;
+  double binaryTime = Seconds(start);
+
+  long long indexSum = 0;
+  start = std::chrono::steady_clock::now();
+  for (int i=0; i<queries; i++)
+    indexSum += index.LowerBound(lookups[i]);
+  double indexTime = Seconds(start);
+
+  int mismatches = 0;
+  for (int i=0; i<queries && i<100000; i++) {
+    if (index.LowerBound(lookups[i]) != std::lower_bound(begin, begin + n, lookups[i]) - begin)
+      mismatches++;
+  }
+
+  cout << "Values: " << n << ", lookups: " << queries << endl;
+  cout << "Eytzinger build:  " << buildTime << " s" << endl;
+  cout << "Binary search:    " << binaryTime << " s (" << 1e9 * binaryTime / queries << " ns per lookup)" << endl;
+  cout << "Eytzinger search: " << indexTime << " s (" << 1e9 * indexTime / queries << " ns per lookup)" << endl;
+  if (mismatches > 0 || indexSum != binarySum) {
+    cout << "Eytzinger results differ from the binary search (" << mismatches << " mismatches)" << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,126 @@
+#ifndef _DNAVIEW_H_
+#define _DNAVIEW_H_
+
+#include "ryggrad/src/general/DNAVector.h"
+
+//======================================================
+/**
+ * Non-owning view of a stretch of a DNAVector, optionally reverse complemented.
+ * The reverse complement is computed base by base on access, so taking a view
+ * or a sub-view never copies. The viewed vector has to outlive the view and must
+ * not be resized while it is viewed. Code that needs an actual DNAVector (e.g.
+ * the cross-correlation signals or the cola aligner) calls Materialize, which
+ * only copies if the view is not the whole vector as is.
+ */
+class DNAView
+{
+public:
+  DNAView(): m_seq(NULL), m_start(0), m_len(0), m_reversed(false) {}
+  /** View of all of seq, implicit so that a DNAVector can be passed where a view is expected */
+  DNAView(const DNAVector & seq, bool reversed = false)
+    : m_seq(&seq), m_start(0), m_len(seq.isize()), m_reversed(reversed) {}
+  DNAView(const DNAVector & seq, int start, int len, bool reversed = false)
+    : m_seq(&seq), m_start(0), m_len(0), m_reversed(reversed) {
+    Clip(start, len, seq.isize());
+    m_start = start;
+    m_len   = len;
+  }
+
+  int  isize() const      { return m_len;      }
+  bool IsReversed() const { return m_reversed; }
+  /** Whether the view is all of the underlying vector in its own orientation */
+  bool IsWhole() const    { return m_seq != NULL && !m_reversed && m_start == 0 && m_len == m_seq->isize(); }
+
+  char operator[](int i) const {
+    if (!m_reversed)
+      return (*m_seq)[m_start + i];
+    return Complement((*m_seq)[m_start + m_len - 1 - i]);
+  }
+
+  /** View of len bases from start on (in view coordinates), clipped to the view */
+  DNAView Sub(int start, int len) const {
+    Clip(start, len, m_len);
+    DNAView sub(*this);
+    sub.m_start = (m_reversed ? m_start + m_len - start - len : m_start + start);
+    sub.m_len   = len;
+    return sub;
+  }
+
+  /** Same bases on the other strand */
+  DNAView ReverseComplement() const {
+    DNAView rc(*this);
+    rc.m_reversed = !m_reversed;
+    return rc;
+  }
+
+  /** Copies the viewed bases into out */
+  void CopyTo(DNAVector & out) const {
+    if (!m_reversed && m_seq != NULL) {
+      out.SetToSubOf(*m_seq, m_start, m_len);
+      return;
+    }
+    out.resize(m_len);
+    for (int i=0; i<m_len; i++)
+      out[i] = (*this)[i];
+  }
+
+  /** The underlying vector if the view covers all of it, otherwise the viewed bases copied into scratch */
+  const DNAVector & Materialize(DNAVector & scratch) const {
+    if (IsWhole())
+      return *m_seq;
+    CopyTo(scratch);
+    return scratch;
+  }
+
+  /** Complement of a base or IUPAC ambiguity code (e.g. R <-> Y), the same as DNAVector::ReverseComplement */
+  static char Complement(char c) {
+    switch (c) {
+    case 'A': return 'T';
+    case 'C': return 'G';
+    case 'G': return 'C';
+    case 'T': return 'A';
+    case 'R': return 'Y';
+    case 'Y': return 'R';
+    case 'K': return 'M';
+    case 'M': return 'K';
+    case 'B': return 'V';
+    case 'V': return 'B';
+    case 'D': return 'H';
+    case 'H': return 'D';
+    case 'a': return 't';
+    case 'c': return 'g';
+    case 'g': return 'c';
+    case 't': return 'a';
+    case 'r': return 'y';
+    case 'y': return 'r';
+    case 'k': return 'm';
+    case 'm': return 'k';
+    case 'b': return 'v';
+    case 'v': return 'b';
+    case 'd': return 'h';
+    case 'h': return 'd';
+    default:  return c;  // N, S, W, gaps and anything else are their own complement
+    }
+  }
+
+private:
+  static void Clip(int & start, int & len, int size) {
+    if (start < 0) {
+      len  += start;
+      start = 0;
+    }
+    if (start > size)
+      start = size;
+    if (len > size - start)
+      len = size - start;
+    if (len < 0)
+      len = 0;
+  }
+
+  const DNAVector * m_seq;   /// Viewed vector
+  int m_start;               /// First viewed base of m_seq
+  int m_len;                 /// Number of viewed bases
+  bool m_reversed;           /// Whether the bases are read reverse complemented
+};
+
+#endif //_DNAVIEW_H_
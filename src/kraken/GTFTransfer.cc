@@ -2,13 +2,15 @@
 #define NDEBUG
 #endif
 
+#include <atomic>
+#include <thread>
 #include "ryggrad/src/base/Logger.h"
 #include "GTFTransfer.h"
 
 //======================================================
 
 void TransAnnotation::translateCoordinates( const string& targetSpecieId, 
-                                           Kraken& mapper) { 
+                                           Kraken& mapper, int numThreads) { 
   if(hasBeenTranslated()) { 
     FILE_LOG(logERROR) <<"Cannot translate coordinates of this annotation \
                           as they have already been translated once"; 
@@ -16,24 +18,66 @@ void TransAnnotation::translateCoordinates( const string& targetSpecieId,
   }
   const svec<AnnotItemBase*>& annotItems = getDataByCoord(AITEM);
   FILE_LOG(logDEBUG) << "Total annotation items to translate: " << annotItems.size();  
+  svec<Coordinate> translated;
+  svec<int> found; // Not svec<bool> as workers write to neighbouring elements concurrently
+  translated.resize(annotItems.isize());
+  found.resize(annotItems.isize());
+
+  // Rough regions of all items in one sweep per route hop, the alignments are then done per item
+  svec<Coordinate> lookups;
+  lookups.resize(annotItems.isize());
   for (int i=0; i<annotItems.isize(); i++) {
-    FILE_LOG(logDEBUG)  << "Translating annotation item: " << i;  
-    FILE_LOG(logDEBUG1) << annotItems[i]->toString('\t');  
-    Coordinate res;
-    bool bOK = mapper.Find(annotItems[i]->getCoords(), this->getTranslateSpace(),
-                           targetSpecieId, res);
-    if (bOK) {
-      FILE_LOG(logDEBUG) << "Item was Translated: " << res.toString('\t');  
-      updateAnnotItem(annotItems[i], res);  
-    }    
+    lookups[i] = annotItems[i]->getCoords();
   }
-  //TODO temp - until sublist has been decoupled
-  for(int mode=0; mode<4; mode++) {
-    for(svec<AnnotItemBase*>::const_iterator it = getDataByCoord(AnnotField(mode)).begin();
-        it != getDataByCoord(AnnotField(mode)).end() ; ++it) {
-      (*it)->setSublist(-1);
+  // Genome names are resolved once, the per item calls only use the handles
+  int sourceId = mapper.GenomeId(this->getTranslateSpace());
+  int targetId = mapper.GenomeId(targetSpecieId);
+  svec< svec<Coordinate> > candidates;
+  mapper.MapItemBatch(lookups, sourceId, targetId, candidates);
+
+  // Workers pick the next untranslated item, each with its own mapper context
+  std::atomic<int> next(0);
+  std::atomic<long long> bufferHits(0), bufferMisses(0);
+  std::atomic<long long> prescreenRejects(0), edgeMaps(0), edgeFallbacks(0);
+  auto worker = [&]() {
+    MapperContext ctx;
+    for (int i=next++; i<annotItems.isize(); i=next++) {
+      FILE_LOG(logDEBUG)  << "Translating annotation item: " << i;  
+      FILE_LOG(logDEBUG1) << annotItems[i]->toString('\t');  
+      found[i] = mapper.RefineItem(lookups[i], sourceId, targetId,
+                                   candidates[i], translated[i], ctx);
+    }
+    bufferHits   += ctx.BufferHits();
+    bufferMisses += ctx.BufferMisses();
+    prescreenRejects += ctx.PrescreenRejects();
+    edgeMaps         += ctx.EdgeMaps();
+    edgeFallbacks    += ctx.EdgeFallbacks();
+  };
+  if(numThreads <= 1) {
+    worker();
+  } else {
+    FILE_LOG(logINFO) << "Translating with " << numThreads << " threads";  
+    svec<std::thread> workers;
+    for (int t=0; t<numThreads; t++) {
+      workers.push_back(std::thread(worker));
+    }
+    for (int t=0; t<numThreads; t++) {
+      workers[t].join();
     }
   }
+
+  FILE_LOG(logINFO) << "Cross-correlation buffer cache: " << bufferHits << " hits, " 
+                    << bufferMisses << " misses";
+  FILE_LOG(logINFO) << "Candidates rejected before the full alignment: " << prescreenRejects;
+  FILE_LOG(logINFO) << "Long items mapped by their edges: " << edgeMaps << ", aligned in full: " << edgeFallbacks;
+
+  // Apply in the original order so that parent transcripts/genes are extended deterministically
+  for (int i=0; i<annotItems.isize(); i++) {
+    if (found[i]) {
+      FILE_LOG(logDEBUG) << "Item was Translated: " << translated[i].toString('\t');  
+      updateAnnotItem(annotItems[i], translated[i]);  
+    }    
+  }
   FILE_LOG(logDEBUG2) << "Start to Sort lists";
   // Sort and Rearrange the data structures now that the coordinates have been transformed
   sortSetNCLists(); 
@@ -72,7 +116,7 @@ void TransAnnotation::writeGTF(ostream& sout, bool outputAll) {
 //======================================================
 void GTFTransfer::translate(TransAnnotation& sourceAnnot, const string& targetId) {
   // Translate the mappings of the source annotaion into targetination annotation space
-  sourceAnnot.translateCoordinates(targetId, m_mapper); 
+  sourceAnnot.translateCoordinates(targetId, m_mapper, m_numThreads); 
 }
 
 void GTFTransfer::reportAllOverlaps(const Annotation& qA, const Annotation& tA, 
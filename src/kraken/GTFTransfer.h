@@ -11,7 +11,8 @@ class TransAnnotation: public Annotation
 { 
 public:
   /** Construct by reading from fileName and setting speciesId */
-  TransAnnotation(const string& fileName, const string& specie):Annotation(fileName, specie), translateSpace(specie) {}
+  TransAnnotation(const string& fileName, const string& specie, IntervalIndexType indexType = NCLIST_INDEX)
+    :Annotation(fileName, specie, indexType), translateSpace(specie) {}
 
   /** Construct from an Annotation object */
   TransAnnotation(const Annotation& annot):Annotation(annot) {
@@ -35,7 +36,12 @@ public:
   const string& getTranslateSpace()  { return translateSpace;                }
   bool hasBeenTranslated()           { return (translateSpace != speciesId); } 
 
-  void translateCoordinates(const string& destSpecieId, Kraken& m_mapper); 
+  /** 
+   * Translates all annotation items into the space of destSpecieId using numThreads workers.
+   * Each worker uses its own mapper context, results are applied in coordinate order so the 
+   * outcome does not depend on the number of threads.
+   */
+  void translateCoordinates(const string& destSpecieId, Kraken& m_mapper, int numThreads=1); 
   virtual void writeGTF(ostream& sout, bool outputAll); 
   
 private:
@@ -55,7 +61,7 @@ private:
 class GTFTransfer:public GTFCompare
 {
 public:
-  GTFTransfer(const string& configFile):m_mapper() {
+  GTFTransfer(const string& configFile):m_mapper(), m_numThreads(1) {
     KrakenConfig config(&m_mapper);
     config.Configure(configFile);
   } 
@@ -67,6 +73,14 @@ public:
   void    setPValThresh(double pvt)        { m_mapper.setPValThresh(pvt);         }
   void    setMinIdent(double mi)           { m_mapper.setMinIdent(mi);            }
   void    setMinAlignCover( double mac)    { m_mapper.setMinAlignCover(mac);      } 
+  void    setSearchIndex(bool si)          { m_mapper.setSearchIndex(si);         }
+  void    setCandidateThreads(int ct)      { m_mapper.setCandidateThreads(ct);    }
+  void    setDominantRatio(double dr)      { m_mapper.setDominantRatio(dr);       }
+  void    setBeamWidth(int bw)             { m_mapper.setBeamWidth(bw);           }
+  void    setAdaptiveWindow(bool aw)       { m_mapper.setAdaptiveWindow(aw);      }
+  void    setEdgeThreshold(int et)         { m_mapper.setEdgeThreshold(et);       }
+  void    setEdgeLength(int el)            { m_mapper.setEdgeLength(el);          }
+  void    setNumThreads(int nt)            { m_numThreads = nt;                   }
 
   virtual void reportAllOverlaps(const Annotation& qA, const Annotation& tA, 
                          AnnotField qFieldType, ostream& sout);
@@ -75,6 +89,7 @@ public:
 
 private:
   Kraken m_mapper;
+  int    m_numThreads;  /// Number of worker threads used for translating annotation items
 };  
 
 
@@ -0,0 +1,60 @@
+#ifndef FORCE_DEBUG
+#define NDEBUG
+#endif
+
+#include "HelperPool.h"
+
+//======================================================
+HelperPool::~HelperPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (int i=0; i<m_threads.isize(); i++)
+    m_threads[i].join();
+}
+
+void HelperPool::Run(int threads, const std::function<void(int)> & job)
+{
+  int helpers = threads - 1;
+  if (helpers <= 0) {
+    job(0);
+    return;
+  }
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (m_threads.isize() < helpers)
+    m_threads.push_back(std::thread(&HelperPool::Loop, this, m_threads.isize()));
+  m_job     = job;
+  m_active  = helpers;
+  m_pending = helpers;
+  m_generation++;
+  lock.unlock();
+  m_wake.notify_all();
+
+  job(0);
+
+  lock.lock();
+  m_done.wait(lock, [this]() { return m_pending == 0; });
+  m_job = nullptr;
+}
+
+void HelperPool::Loop(int index)
+{
+  int seen = 0;
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_wake.wait(lock, [&]() { return m_stop || m_generation != seen; });
+    if (m_stop)
+      return;
+    seen = m_generation;
+    if (index >= m_active)
+      continue;  // Not needed for this job
+    lock.unlock();
+    m_job(index + 1);
+    lock.lock();
+    if (--m_pending == 0)
+      m_done.notify_one();
+  }
+}
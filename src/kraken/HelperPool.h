@@ -0,0 +1,47 @@
+#ifndef _HELPERPOOL_H_
+#define _HELPERPOOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "ryggrad/src/base/SVector.h"
+
+//======================================================
+/**
+ * Helper threads kept for the lifetime of the pool, so that work split over a
+ * few threads many times (e.g. the candidates of each lookup) does not start
+ * and join threads every time. Threads are started on first use, as many as
+ * have been asked for so far. One caller at a time.
+ */
+class HelperPool
+{
+public:
+  HelperPool(): m_threads(), m_mutex(), m_wake(), m_done(), m_job(), m_generation(0), 
+                m_active(0), m_pending(0), m_stop(false) {}
+  ~HelperPool();
+
+  HelperPool(const HelperPool&) = delete;
+  HelperPool& operator=(const HelperPool&) = delete;
+
+  /** 
+   * Runs job(0) on the calling thread and job(1) to job(threads-1) on helpers at the 
+   * same time, returns once all of them have finished.
+   */
+  void Run(int threads, const std::function<void(int)> & job);
+
+private:
+  void Loop(int index);
+
+  svec<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;  /// Signals a new job (or stop) to the helpers
+  std::condition_variable m_done;  /// Signals the caller that the last helper finished
+  std::function<void(int)> m_job;  /// Current job
+  int m_generation;                /// Incremented for each job, so that a helper runs it once
+  int m_active;                    /// Number of helpers taking part in the current job
+  int m_pending;                   /// Number of those still running it
+  bool m_stop;                     /// Set when the pool is destroyed
+};
+
+#endif //_HELPERPOOL_H_
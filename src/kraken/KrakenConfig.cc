@@ -13,7 +13,8 @@ enum K_SECTION
   K_SECTION_NONE,
   K_SECTION_GENOME,
   K_SECTION_MAP,
-  K_SECTION_XMFA
+  K_SECTION_XMFA,
+  K_SECTION_PRELOAD
 };
 
 
@@ -28,6 +29,9 @@ bool KrakenConfig::Configure(const string & fileName)
 
   svec<string> genome, file;
   svec<string> kmap, g1, g2;
+  svec<double> dist;
+  svec<int> preferred;
+  svec<string> preload;
 
   int i;
 
@@ -50,9 +54,16 @@ bool KrakenConfig::Configure(const string & fileName)
       s = K_SECTION_XMFA;
       continue;
     }    
+    if (parser.AsString(0) == "[preload]") {
+      s = K_SECTION_PRELOAD;
+      continue;
+    }    
     switch(s) {
     case K_SECTION_NONE:
       break;
+    case K_SECTION_PRELOAD:
+      preload.push_back(parser.AsString(0));
+      break;
     case K_SECTION_GENOME:
       genome.push_back(parser.AsString(0));
       file.push_back(parser.AsString(1));     
@@ -61,6 +72,9 @@ bool KrakenConfig::Configure(const string & fileName)
       kmap.push_back(parser.AsString(2));
       g1.push_back(parser.AsString(0));     
       g2.push_back(parser.AsString(1));     
+      // Optional distance used for routing, optionally followed by "preferred"
+      dist.push_back(parser.GetItemCount() > 3 ? parser.AsFloat(3) : 0.5);
+      preferred.push_back(parser.GetItemCount() > 4 && parser.AsString(4) == "preferred");
       break;
     case K_SECTION_XMFA:
 //      cout << "Creating directory " << output << endl;
@@ -76,6 +90,8 @@ bool KrakenConfig::Configure(const string & fileName)
         kmap.push_back(sParser.AsString(2));
         g1.push_back(sParser.AsString(0));     
         g2.push_back(sParser.AsString(1));     
+        dist.push_back(0.5);
+        preferred.push_back(false);
       }
       break;
     }
@@ -83,19 +99,25 @@ bool KrakenConfig::Configure(const string & fileName)
   }
 
   for (i=0; i<kmap.isize(); i++) {
-    m_pKraken->Allocate(g1[i], g2[i]);
+    m_pKraken->Allocate(g1[i], g2[i], dist[i], preferred[i] != 0);
   }
 
   m_pKraken->DoneAlloc();
   FILE_LOG(logDEBUG) << "Done allocating genomes.";  
+  // Maps and genomes are only read once a lookup needs them, unless listed in the preload section
   for (i=0; i<kmap.isize(); i++) {
-    FILE_LOG(logDEBUG) << "Reading map: " << kmap[i];  
-    m_pKraken->ReadMap(kmap[i], g1[i], g2[i]);
+    FILE_LOG(logDEBUG) << "Registering map: " << kmap[i];  
+    m_pKraken->RegisterMap(kmap[i], g1[i], g2[i], dist[i]);
   }
 
   for (i=0; i<genome.isize(); i++) {
-    FILE_LOG(logDEBUG) << "Reading genome: " << genome[i] << "\t" << file[i]; 
-    m_pKraken->ReadGenome(file[i], genome[i]);
+    FILE_LOG(logDEBUG) << "Registering genome: " << genome[i] << "\t" << file[i]; 
+    m_pKraken->RegisterGenome(file[i], genome[i]);
+  }
+
+  for (i=0; i<preload.isize(); i++) {
+    FILE_LOG(logDEBUG) << "Preloading genome: " << preload[i]; 
+    m_pKraken->Preload(preload[i]);
   }
   FILE_LOG(logDEBUG) << "Done reading!";
   return true;
@@ -60,19 +60,18 @@ int main(int argc,char** argv) {
 void KrakenEvaluator::compareAllMapGenomes(Kraken& mapper1, Kraken& mapper2, int percentage, int blockSize) {
   // Go through all the genomes in mapper1, split into blocks
   // and map over to all other genomes via both mappers
-  svec<GenomeSeq> genomes = mapper1.GetGenomes();
+  const svec<GenomeSeq>& genomes = mapper1.GetGenomes();
   for(int i=0; i<genomes.isize(); i++) {
-    string origin           = genomes[i].Name();
-    vecDNAVector origGenome = genomes[i].DNA();
+    string origin               = genomes[i].Name();
+    const GenomeSeq& origGenome = genomes[i];
     for(int j=i+1; j<genomes.isize(); j++) {
       string destin           = genomes[j].Name();
       FILE_LOG(logINFO)  << "Mapping blocks from genome: " << origin << " to: " << destin; 
-      for(int x=0; x<origGenome.isize(); x++) {
-        if(origGenome[x].size() < 5000000) { continue; }  // Only choose blocks from larger scaffolds
-        for(int y=0; y<origGenome[x].isize()-blockSize*2; y+=blockSize) {
+      for(int x=0; x<origGenome.ChromosomeCount(); x++) {
+        if(origGenome.ChromosomeSize(x) < 5000000) { continue; }  // Only choose blocks from larger scaffolds
+        for(int y=0; y<origGenome.ChromosomeSize(x)-blockSize*2; y+=blockSize) {
           if(rand()%(100)>=percentage) { continue; } //Only analyse a given percentage of the dataset
-          string chrName = origGenome[x].getName();
-          chrName.erase(std::remove(chrName.begin(), chrName.end(), '>'), chrName.end());
+          string chrName = origGenome.ChromosomeName(x);
           Coordinate origCoords(chrName, true, y, y+blockSize-1);
           if(origCoords.findLength()>1000) {
             compareMapOutputs(mapper1, mapper2, origCoords, origin, destin, true, 100);
@@ -87,7 +86,7 @@ void KrakenEvaluator::compareAllMapGenomes(Kraken& mapper1, Kraken& mapper2, int
 
 void KrakenEvaluator::compareAnnotationAllMapGenomes(Kraken& mapper1, Kraken& mapper2, const Annotation& origAnnot, 
                                      const string& origin, AnnotField qFieldType) {
-  svec<GenomeSeq> genomes = mapper1.GetGenomes();
+  const svec<GenomeSeq>& genomes = mapper1.GetGenomes();
   for(int i=0; i<genomes.isize(); i++) {
     string destin = genomes[i].Name();
     compareAnnotation(mapper1, mapper2, origAnnot, origin, destin, qFieldType); 
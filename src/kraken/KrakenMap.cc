@@ -2,10 +2,21 @@
 #define NDEBUG
 #endif
 
+#include <functional>
 #include "KrakenMap.h"
 #include "ryggrad/src/base/FileParser.h"
 #include "cola/src/cola/Cola.h"
 
+// Const counterpart of BinSearch: index of val in the sorted vector v, -1 if not present
+template<class T>
+static int SortedIndex(const svec<T> & v, const T & val)
+{
+  typename svec<T>::const_iterator it = lower_bound(v.begin(), v.end(), val);
+  if (it == v.end() || val < *it)
+    return -1;
+  return (int)(it - v.begin());
+}
+
 void GenomeWideMap::Read(const string & fileName, 
 			 const string & source, 
 			 const string & target, 
@@ -14,113 +25,160 @@ void GenomeWideMap::Read(const string & fileName,
 {
   m_source = source;
   m_target = target;
+  SetFile(fileName, flip);
+  Load();
+}
 
-  FlatFileParser parser;
-  parser.Open(fileName);
-  
-  int i = -1;
-  do {
-    i++;
-    if (i >= m_blocks.isize())
-      m_blocks.resize(i + 1000000);
-  } while (m_blocks[i].parse(parser, flip));
-  m_blocks.resize(i+1);
+void GenomeWideMap::Load() const
+{
+  m_loader.Run([this]() {
+    if (m_fileName == "")
+      return;
+    FILE_LOG(logDEBUG) << "Reading map: " << m_fileName << " (" << m_source << " -> " << m_target << ")";
+    SyntenyCache::Read(m_fileName, m_flip, m_blocks);
+    m_blocks.BuildSearchIndex();
+    FILE_LOG(logDEBUG) << "Syntenic blocks: " << m_blocks.Size();
+  });
+}
 
-  Sort(m_blocks);
-  MergeBlocks();
-  FILE_LOG(logDEBUG) << "Syntenic blocks: " << m_blocks.isize();
+string GenomeWideMap::BlockString(int i) const
+{
+  stringstream out;
+  out << m_blocks.targetChroms[m_blocks.TargetChrom(i)] << " " << m_blocks.targetStart[i] << " " 
+      << m_blocks.targetStop[i] << " " << m_blocks.queryChroms[m_blocks.queryChrom[i]] << " " 
+      << m_blocks.queryStart[i] << " " << m_blocks.queryStop[i] << " " << (m_blocks.reversed[i] ? "-" : "+");
+  return out.str();
 }
 
-void GenomeWideMap::MergeBlocks()
+bool GenomeWideMap::Map(const Coordinate & lookup, svec<Coordinate>& results, int mapSizeLimit, bool searchIndex) const
 {
-  
-  int i, j;
-  svec<AlignmentBlock> tmp;
-  tmp.resize(m_blocks.isize());
-  j = 0;
-  int k = 0;
-
-  for (i=0; i<m_blocks.isize(); i++) {
-    if (m_blocks[i].getOrient() == tmp[k].getOrient() &&
-	m_blocks[i].getTargetChrom() == tmp[k].getTargetChrom() &&
-	m_blocks[i].getQueryChrom() == tmp[k].getQueryChrom() &&	
-	m_blocks[i].getTargetStart() < tmp[k].getTargetStop()) {      
-      /*      if (m_blocks[i].getTargetStop() > tmp[k].getTargetStop())
-	tmp[k].setStopT(m_blocks[i].getTargetStop());
-      if (m_blocks[i].getQueryStop() > tmp[k].getQueryStop())
-	tmp[k].setStopQ(m_blocks[i].getQueryStop());
-      if (m_blocks[i].getQueryStart() < tmp[k].getQueryStart())
-      tmp[k].setStartQ(m_blocks[i].getQueryStart());*/
+  Load();
+  int chrom = m_blocks.TargetChromId(lookup.getChr());
+  if (chrom == -1) {
+    FILE_LOG(logDEBUG1) << "Not found synteny for start of source - Code1"; 
+    FILE_LOG(logDEBUG3) << "No blocks on look up chromosome: "<< lookup.getChr();
+    return false;
+  }
+  return MapBlocks(lookup, chrom, m_blocks.LowerBound(chrom, lookup.getStart(), searchIndex),
+                   m_blocks.LowerBound(chrom, lookup.getStop(), searchIndex), results, mapSizeLimit);
+}
+
+// Lower bound of x in [first, last) found by doubling steps from first, for x close to a[first]
+static int GallopLowerBound(const int32_t * a, int first, int last, int x)
+{
+  int lo = first;
+  int step = 1;
+  while (lo + step < last && a[lo + step] < x) {
+    lo += step;
+    step *= 2;
+  }
+  return (int)(lower_bound(a + lo, a + min(lo + step, last), x) - a);
+}
+
+void GenomeWideMap::MapBatch(const svec<Coordinate> & lookups, svec< svec<Coordinate> > & results, 
+                             int mapSizeLimit) const
+{
+  Load();
+  results.clear();
+  results.resize(lookups.isize());
+
+  // Order the lookups by chromosome id and start so that one forward sweep finds all begin blocks
+  svec<BatchItem> items;
+  items.reserve(lookups.isize());
+  int chrom = -1;
+  int i;
+  for (i=0; i<lookups.isize(); i++) {
+    if (i == 0 || lookups[i].getChr() != lookups[i-1].getChr())
+      chrom = m_blocks.TargetChromId(lookups[i].getChr());
+    if (chrom == -1) {
+      FILE_LOG(logDEBUG1) << "Not found synteny for start of source - Code1"; 
+      FILE_LOG(logDEBUG3) << "No blocks on look up chromosome: "<< lookups[i].getChr();
       continue;
     }
-    tmp[k] = m_blocks[i];
-    k++;
+    BatchItem item;
+    item.chrom = chrom;
+    item.start = lookups[i].getStart();
+    item.index = i;
+    items.push_back(item);
+  }
+  sort(items.begin(), items.end());
+
+  const int32_t * starts = m_blocks.targetStart.empty() ? NULL : &m_blocks.targetStart[0];
+  int cursor = 0;
+  for (i=0; i<items.isize(); i++) {
+    const BatchItem & item = items[i];
+    int last = m_blocks.ChromEnd(item.chrom);
+    if (i == 0 || item.chrom != items[i-1].chrom)
+      cursor = m_blocks.ChromBegin(item.chrom);
+    while (cursor < last && starts[cursor] < item.start)
+      cursor++;
+    // Stops lie close after their starts, so the end block is searched onwards from the begin block
+    const Coordinate & lookup = lookups[item.index];
+    int stop = cursor;
+    if (lookup.getStop() >= item.start) {
+      stop = GallopLowerBound(starts, cursor, last, lookup.getStop());
+    } else {
+      stop = (int)(lower_bound(starts + m_blocks.ChromBegin(item.chrom), starts + cursor, lookup.getStop()) - starts);
+    }
+    MapBlocks(lookup, item.chrom, cursor, stop, results[item.index], mapSizeLimit);
   }
-
-  tmp.resize(k);
-  m_blocks = tmp;
-  
 }
 
-//TODO Kraken functions are not const where they should be, underlying FuzzySearch.. functions need to be fixed first
-bool GenomeWideMap::Map(const Coordinate & lookup, svec<Coordinate>& results, int mapSizeLimit)
+bool GenomeWideMap::MapBlocks(const Coordinate & lookup, int chrom, int startIndex, int stopIndex,
+                              svec<Coordinate>& results, int mapSizeLimit) const
 {
-  AlignmentBlock tmp;
-  tmp.set(lookup.getChr(), lookup.getStart(), lookup.getStart());
+  // Blocks of the lookup chromosome are [first, last)
+  int first = m_blocks.ChromBegin(chrom);
+  int last  = m_blocks.ChromEnd(chrom);
 
-  long long index = BinSearchFuzzy(m_blocks, tmp);
-  if ((index == 0) || (index >= m_blocks.isize())) {
+  int index = startIndex;
+  if ((index == 0) || (index >= m_blocks.Size())) {
     FILE_LOG(logDEBUG3) << "Initial target region not found for lookup start - code2";
     return false;
   }
 
-  AlignmentBlock begin = m_blocks[index-1];
-
   FILE_LOG(logDEBUG3) << "Index=" << index;
-  FILE_LOG(logDEBUG3) << tmp.toString();
-  FILE_LOG(logDEBUG3) << begin.toString();
-  if (begin.getTargetChrom() != lookup.getChr()) {
+  FILE_LOG(logDEBUG3) << BlockString(index-1);
+  if (index == first) {
     FILE_LOG(logDEBUG1) << "Not found synteny for start of source - Code1"; 
-    FILE_LOG(logDEBUG3) << "Found block source chrom: " << begin.getTargetChrom() 
+    FILE_LOG(logDEBUG3) << "Found block source chrom: " << m_blocks.targetChroms[m_blocks.TargetChrom(index-1)] 
                         << "  look up chromosome: "<< lookup.getChr();
     return false;
   }
+  int begin = index-1;
 
-  tmp.set(lookup.getChr(), lookup.getStop(), lookup.getStop());
-  index = BinSearchFuzzy(m_blocks, tmp);
-  if ((index == 0) || (index >= m_blocks.isize())) {
+  index = stopIndex;
+  if ((index == 0) || (index >= m_blocks.Size())) {
     FILE_LOG(logDEBUG1) << "Initial target region not found for lookup stop - code3";
     return false;
   }
 
-  AlignmentBlock end = m_blocks[index-1];
+  int end = index-1;
   // If lookup region is not covered then extend
-  if ((end.getTargetStop() < lookup.getStop()) 
-      && m_blocks[index].getTargetChrom()==lookup.getChr()) {  
-    end = m_blocks[index]; 
+  if ((m_blocks.targetStop[end] < lookup.getStop()) && index < last) {  
+    end = index; 
   }
 
-  if (end.getTargetChrom() != lookup.getChr()) {
+  if (end < first) {
     FILE_LOG(logDEBUG1) << "Not found synteny for end of source - code4"; 
     return false;
   }
 
   FILE_LOG(logDEBUG3) << "Index=" << index;
-  FILE_LOG(logDEBUG3) << tmp.toString();
-  FILE_LOG(logDEBUG3) << end.toString();
+  FILE_LOG(logDEBUG3) << BlockString(end);
 
   bool split = false;
-  if (begin.getQueryChrom() != end.getQueryChrom()) {
+  if (m_blocks.queryChrom[begin] != m_blocks.queryChrom[end]) {
     FILE_LOG(logDEBUG2) << "Start & stop of initial target region not on the same Chromosome - Code5";
-    FILE_LOG(logDEBUG3) << "Start: " << begin.toString() << " Stop: "<< end.toString(); 
+    FILE_LOG(logDEBUG3) << "Start: " << BlockString(begin) << " Stop: "<< BlockString(end); 
     split = true; 
   }
   int threshold = max(mapSizeLimit, 10*lookup.findLength());
-  if (abs(end.getQueryStop()-begin.getQueryStart()) > threshold 
-     || abs(begin.getQueryStop() - end.getQueryStart()) > threshold) { 
+  if (abs(m_blocks.queryStop[end] - m_blocks.queryStart[begin]) > threshold 
+     || abs(m_blocks.queryStop[begin] - m_blocks.queryStart[end]) > threshold) { 
     FILE_LOG(logDEBUG1) << "Initial target region too big - code6: "
-                        << end.getQueryStop() - begin.getQueryStart() << " "
-                        << begin.getQueryStop() - end.getQueryStart();
+                        << m_blocks.queryStop[end] - m_blocks.queryStart[begin] << " "
+                        << m_blocks.queryStop[begin] - m_blocks.queryStart[end];
     split = true;
   }
   if(split) {
@@ -140,30 +198,31 @@ bool GenomeWideMap::Map(const Coordinate & lookup, svec<Coordinate>& results, in
   return true;
 }
 
-void GenomeWideMap::SetAnchors(const Coordinate & lookup, const AlignmentBlock& begin, 
-                               const AlignmentBlock& end, int startExtend, int stopExtend,
-                               Coordinate & result) {
+void GenomeWideMap::SetAnchors(const Coordinate & lookup, int begin, int end, 
+                               int startExtend, int stopExtend, Coordinate & result) const {
 
-  AlignmentBlock beginAdj(begin), endAdj(end); //Blocks adjusted by considering reversed start/stop
-  if(begin.isReversed() && end.isReversed()) {
+  //Blocks adjusted by considering reversed start/stop
+  int beginAdj = begin;
+  int endAdj   = end;
+  if(m_blocks.reversed[begin] && m_blocks.reversed[end]) {
     beginAdj = end;
     endAdj   = begin;
   }
 
-  result.setChr(begin.getQueryChrom());
-  result.setOrient(begin.getOrient());
+  result.setChr(m_blocks.queryChroms[m_blocks.queryChrom[begin]]);
+  result.setOrient(!m_blocks.reversed[begin]);
 
   if(startExtend==0 && stopExtend==0) { 
-    result.setStart(beginAdj.getQueryStart());
-    result.setStop(endAdj.getQueryStop());
+    result.setStart(m_blocks.queryStart[beginAdj]);
+    result.setStop(m_blocks.queryStop[endAdj]);
   } else if(startExtend!=0) {
-    result.setStart(begin.getQueryStop() - startExtend);
-    result.setStop(begin.getQueryStop() + startExtend);
+    result.setStart(m_blocks.queryStop[begin] - startExtend);
+    result.setStop(m_blocks.queryStop[begin] + startExtend);
   } else { //stopExtend!=0
-    result.setChr(end.getQueryChrom()); //chromosome name should be end.chr
-    result.setOrient(end.getOrient()); //chromosome orientation should be end.orient
-    result.setStart(end.getQueryStop() - stopExtend);
-    result.setStop(end.getQueryStop() + stopExtend);
+    result.setChr(m_blocks.queryChroms[m_blocks.queryChrom[end]]); //chromosome name should be end.chr
+    result.setOrient(!m_blocks.reversed[end]); //chromosome orientation should be end.orient
+    result.setStart(m_blocks.queryStop[end] - stopExtend);
+    result.setStop(m_blocks.queryStop[end] + stopExtend);
   }
   
   if (result.getStop() < result.getStart()) {
@@ -189,10 +248,103 @@ void GenomeWideMap::SetAnchors(const Coordinate & lookup, const AlignmentBlock&
 
 //==================================================
 
-void Kraken::Allocate(const string & source, const string & target, double distance)
+void GenomeSeq::Read(const string & fileName, const string & genome)
+{
+  m_name = genome;
+  SetFile(fileName);
+  Load();
+}
+
+void GenomeSeq::Load() const
+{
+  m_loader.Run([this]() {
+    if (m_fileName == "")
+      return;
+    FILE_LOG(logDEBUG) << "Reading genome: " << m_name << "\t" << m_fileName; 
+    if (PackedGenome::IsPacked(m_fileName)) {
+      if (!m_packed.Open(m_fileName))
+        FILE_LOG(logERROR) << "Could not load packed genome " << m_name << ", lookups on it will fail: " << m_fileName;
+    } else {
+      m_dna.Read(m_fileName);
+    }
+  });
+}
+
+int GenomeSeq::ChromosomeCount() const
+{
+  if (IsPacked())
+    return m_packed.ChromCount();
+  return m_dna.isize();
+}
+
+string GenomeSeq::ChromosomeName(int i) const
+{
+  if (IsPacked())
+    return m_packed.ChromName(i);
+  return PackedGenome::CoordName(m_dna[i].getName());
+}
+
+int GenomeSeq::ChromosomeSize(int i) const
+{
+  if (IsPacked())
+    return m_packed.ChromSize(i);
+  return m_dna[i].isize();
+}
+
+bool GenomeSeq::HasChromosome(const string & chr) const
+{
+  Load();
+  if (IsPacked())
+    return (m_packed.ChromIndex(chr) != -1);
+  return m_dna.HasChromosome(chr);
+}
+
+int GenomeSeq::ChromosomeSize(const string & chr) const
+{
+  Load();
+  if (IsPacked()) {
+    int i = m_packed.ChromIndex(chr);
+    return (i == -1 ? -1 : m_packed.ChromSize(i));
+  }
+  if (!m_dna.HasChromosome(chr))
+    return -1;
+  return m_dna(chr).isize();
+}
+
+bool GenomeSeq::Extract(const string & chr, int start, int len, DNAVector & seq) const
+{
+  Load();
+  if (!IsPacked())
+    return seq.SetToSubOf(m_dna(chr), start, len);
+  if (len <= 0)
+    return false;
+  m_packed.Extract(m_packed.ChromIndex(chr), start, len, seq);
+  return true;
+}
+
+bool GenomeSeq::SetSequence(const Coordinate & coords, DNAVector & seq) const
+{
+  Load();
+  if (!IsPacked())
+    return m_dna.SetSequence(coords, seq);
+
+  int size = ChromosomeSize(coords.getChr());
+  if (size == -1 || coords.getStart() < 0 || coords.getStop() >= size || coords.getStop() < coords.getStart())
+    return false;
+  if (!Extract(coords.getChr(), coords.getStart(), coords.getStop() - coords.getStart() + 1, seq))
+    return false;
+  if (coords.isReversed())
+    seq.ReverseComplement();
+  return true;
+}
+
+//==================================================
+
+void Kraken::Allocate(const string & source, const string & target, double distance, bool preferred)
 {
   GenomeWideMap tmp;
   tmp.Set(source, target, distance);
+  tmp.SetPreferred(preferred);
   m_maps.push_back(tmp);
 
   tmp.Set(target, source, distance);
@@ -209,20 +361,18 @@ void Kraken::DoneAlloc()
   for (int i=0; i<m_maps.isize(); i++)
     m_maps[i].Print();
 
-  m_router.SetNumGenomes(m_seq.isize());
-  int i, j;
-  for (i=0; i<m_seq.isize(); i++) {
-    for (j=0; j<m_seq.isize(); j++) {
-      if (i == j)
-	continue;
-      Route out;
-      // Find the route between genomes
-      m_router.FindRoute(out, m_seq[i].Name(), m_seq[j].Name(), *this);
-    }
-  }
+  // The routes between genomes are found on first use, once all maps have been registered
+  m_routesBuilt.Reset();
 }
 
 void Kraken::ReadMap(const string & fileName, const string & source, const string & target, double distance)
+{
+  RegisterMap(fileName, source, target, distance);
+  m_maps[Index(source, target)].Load();
+  m_maps[Index(target, source)].Load();
+}
+
+void Kraken::RegisterMap(const string & fileName, const string & source, const string & target, double distance)
 {
   int index = Index(source, target);
   bool bSort = false;
@@ -231,9 +381,10 @@ void Kraken::ReadMap(const string & fileName, const string & source, const strin
     bSort = true;
     index = m_maps.isize();
     m_maps.resize(index+1);
+    m_maps[index].Set(source, target, distance);
   }
   
-  m_maps[index].Read(fileName, source, target, false, distance);
+  m_maps[index].SetFile(fileName, false);
 
   index = Index(target, source);
   if (index == -1) {
@@ -241,15 +392,24 @@ void Kraken::ReadMap(const string & fileName, const string & source, const strin
     bSort = true;
     index = m_maps.isize();
     m_maps.resize(index+1);
+    m_maps[index].Set(target, source, distance);
   }
 
-  m_maps[index].Read(fileName, target, source, true, distance);
+  m_maps[index].SetFile(fileName, true);
   
-  if (bSort)
+  if (bSort) {
     Sort(m_maps);
+    m_routesBuilt.Reset();
+  }
 }
  
 void Kraken::ReadGenome(const string & fileName, const string & name)
+{
+  RegisterGenome(fileName, name);
+  m_seq[Genome(name)].Load();
+}
+
+void Kraken::RegisterGenome(const string & fileName, const string & name)
 {
   UniqueSort(m_seq);
   int i = Genome(name);
@@ -258,45 +418,207 @@ void Kraken::ReadGenome(const string & fileName, const string & name)
     bSort = true;
     i = m_seq.isize();
     m_seq.resize(i+1);
+    m_seq[i].SetName(name);
     FILE_LOG(logWARNING) << "Warning: genome " << name 
                          << " has not been pre-allocated!!";
   }
 
-  m_seq[i].Read(fileName, name);
+  m_seq[i].SetFile(fileName);
 
-  if (bSort)
+  if (bSort) {
     UniqueSort(m_seq);
+    m_routesBuilt.Reset();
+  }
+}
+
+void Kraken::Preload(const string & name)
+{
+  int i = Genome(name);
+  if (i == -1) {
+    FILE_LOG(logWARNING) << "Warning: cannot preload unknown genome " << name;
+    return;
+  }
+  m_seq[i].Load();
+  for (i=0; i<m_maps.isize(); i++) {
+    if (m_maps[i].Origin() == name || m_maps[i].Destination() == name)
+      m_maps[i].Load();
+  }
 }
  
-bool Kraken::MapThroughRoute(const Route & route, svec<Coordinate>& results, const Coordinate & lookup)
+// Appends the candidates of found that do not overlap one already in beam, until beam holds 
+// width candidates (no limit if width is 0). Earlier candidates take precedence.
+static void AddToBeam(svec<Coordinate> & beam, const svec<Coordinate> & found, int width)
+{
+  for (int i=0; i<found.isize(); i++) {
+    if (width > 0 && beam.isize() >= width)
+      return;
+    const Coordinate & c = found[i];
+    bool overlaps = false;
+    for (int j=0; j<beam.isize() && !overlaps; j++) {
+      overlaps = (beam[j].getChr() == c.getChr() && beam[j].isReversed() == c.isReversed()
+                  && beam[j].getStart() <= c.getStop() && c.getStart() <= beam[j].getStop());
+    }
+    if (!overlaps)
+      beam.push_back(c);
+  }
+}
+
+// Appends the candidates of found that are not already in results. Unlike AddToBeam, candidates
+// overlapping one in results are kept, as the final hop returns every candidate of each region
+// it maps, so that a wider beam only adds candidates to those width 1 gives.
+static void AddDistinct(svec<Coordinate> & results, const svec<Coordinate> & found)
+{
+  for (int i=0; i<found.isize(); i++) {
+    const Coordinate & c = found[i];
+    bool seen = false;
+    for (int j=0; j<results.isize() && !seen; j++) {
+      seen = (results[j].getChr() == c.getChr() && results[j].isReversed() == c.isReversed()
+              && results[j].getStart() == c.getStart() && results[j].getStop() == c.getStop());
+    }
+    if (!seen)
+      results.push_back(c);
+  }
+}
+
+bool Kraken::MapThroughRoute(const Route & route, svec<Coordinate>& results, const Coordinate & lookup) const
 {
-  Coordinate tempLookup = lookup;
   FILE_LOG(logDEBUG4) << "Route: count=" << route.GetCount();
-  int i;
+  int i, j;
   for (i=0; i<route.GetCount(); i++) {
-    const string & source = route.Origin(i);
-    const string & target = route.Destination(i);
-    FILE_LOG(logDEBUG3) << source << " -> " << target;
+    FILE_LOG(logDEBUG3) << GenomeName(route.Origin(i)) << " -> " << GenomeName(route.Destination(i));
   }
 
+  // Candidates carried from hop to hop, at most beamWidth of them between hops
+  int beamWidth = max(1, m_params.getBeamWidth());
+  svec<Coordinate> current;
+  current.push_back(lookup);
+  svec<Coordinate> hopResults;
+  results.clear();
   for (i=0; i<route.GetCount(); i++) {
+    FILE_LOG(logDEBUG3) << "Mapping " << GenomeName(route.Origin(i)) << " and " << GenomeName(route.Destination(i));
+    bool lastHop = (i == route.GetCount() - 1);
+    int index = route.Map(i);
     results.clear();
-    const string & source = route.Origin(i);
-    const string & target = route.Destination(i);
-    FILE_LOG(logDEBUG3) << "Mapping " << source << " and " << target;
-    int index = Index(source, target);
-    Coordinate tmp;
-    if (!m_maps[index].Map(tempLookup, results, m_params.getMapSizeLimit())) {
-      FILE_LOG(logDEBUG2) << "No map found between " << source << " and " << target;
+    for (j=0; j<current.isize(); j++) {
+      hopResults.clear();
+      if (!m_maps[index].Map(current[j], hopResults, m_params.getMapSizeLimit(), m_params.isSearchIndex())) 
+        continue;
+      if (lastHop && beamWidth == 1) 
+        results = hopResults;
+      else if (lastHop)
+        AddDistinct(results, hopResults);
+      else
+        AddToBeam(results, hopResults, beamWidth);
+    }
+    if (results.isize() == 0) {
+      FILE_LOG(logDEBUG2) << "No map found between " << GenomeName(route.Origin(i)) << " and " << GenomeName(route.Destination(i));
       return false;
     }
-    tempLookup = results[0]; //TODO all results might need to be looked at eveyr stage
+    current = results;
   }
   
   FILE_LOG(logDEBUG2) << "Found " << results.size() << " set/sets of possible mappings";
   return (results.size()>0);
 }
 
+bool Kraken::MapThroughRoute(const Route & route, svec< svec<Coordinate> >& results, 
+                             const svec<Coordinate> & lookups) const
+{
+  results.clear();
+  results.resize(lookups.isize());
+  // Candidates still alive after the current hop and the positions of their lookups in the batch,
+  // the candidates of one lookup are kept next to each other
+  svec<Coordinate> current = lookups;
+  svec<int> origin;
+  origin.resize(lookups.isize());
+  int i, j;
+  for (j=0; j<origin.isize(); j++)
+    origin[j] = j;
+
+  int beamWidth = max(1, m_params.getBeamWidth());
+  svec< svec<Coordinate> > hopResults;
+  svec<Coordinate> beam;
+  for (i=0; i<route.GetCount() && current.isize() > 0; i++) {
+    FILE_LOG(logDEBUG3) << "Mapping batch of " << current.isize() << " between " << GenomeName(route.Origin(i)) 
+                        << " and " << GenomeName(route.Destination(i));
+    m_maps[route.Map(i)].MapBatch(current, hopResults, m_params.getMapSizeLimit());
+    if (i == route.GetCount() - 1) {
+      for (j=0; j<current.isize(); j++) {
+        if (beamWidth == 1)
+          swap(results[origin[j]], hopResults[j]);
+        else
+          AddDistinct(results[origin[j]], hopResults[j]);
+      }
+      break;
+    }
+    // Next beam of each lookup from the regions of all its current candidates
+    svec<Coordinate> next;
+    svec<int> nextOrigin;
+    for (j=0; j<current.isize(); ) {
+      int k = j;
+      beam.clear();
+      for (; k<current.isize() && origin[k] == origin[j]; k++)
+        AddToBeam(beam, hopResults[k], beamWidth);
+      for (int b=0; b<beam.isize(); b++) {
+        next.push_back(beam[b]);
+        nextOrigin.push_back(origin[j]);
+      }
+      j = k;
+    }
+    swap(current, next);
+    swap(origin, nextOrigin);
+  }
+
+  for (j=0; j<results.isize(); j++) {
+    if (results[j].isize() > 0)
+      return true;
+  }
+  return false;
+}
+
+bool Kraken::MapBatch(const svec<Coordinate> & lookups, int source, int target,
+                      svec< svec<Coordinate> > & candidates) const
+{
+  const Route & route = Router().FindRoute(source, target);
+  if (route.IsInvalid()) {
+    FILE_LOG(logDEBUG2) << "NO route!";
+    candidates.clear();
+    candidates.resize(lookups.isize());
+    return false;
+  }
+  return MapThroughRoute(route, candidates, lookups);
+}
+
+//==================================================
+long long MapperContext::BufferHits() const
+{
+  long long n = m_bufferHits;
+  for (int i=0; i<m_workers.isize(); i++)
+    n += m_workers[i]->BufferHits();
+  return n;
+}
+
+long long MapperContext::BufferMisses() const
+{
+  long long n = m_bufferMisses;
+  for (int i=0; i<m_workers.isize(); i++)
+    n += m_workers[i]->BufferMisses();
+  return n;
+}
+
+std::shared_ptr<TargetWindow> MapperContext::NextWindow()
+{
+  const int WINDOW_CACHE_SIZE = 4;
+  if (m_windows.isize() < WINDOW_CACHE_SIZE) 
+    m_windows.resize(WINDOW_CACHE_SIZE);
+  std::shared_ptr<TargetWindow> & window = m_windows[m_nextWindow];
+  m_nextWindow = (m_nextWindow + 1) % WINDOW_CACHE_SIZE;
+  if (!window || window.use_count() > 1)
+    window = std::make_shared<TargetWindow>();
+  return window;
+}
+
+//==================================================
 const GenomeWideMap & Kraken::GetMap(const string & name) const 
 {
   double dist = 9999.;
@@ -312,9 +634,9 @@ const GenomeWideMap & Kraken::GetMap(const string & name) const
   return m_maps[index];
 }
 
-bool Kraken::FindWithEdges(const Coordinate& lookup, const string & source,
-                   const string & target, int edgeLength,
-                   Coordinate& result) 
+bool Kraken::FindWithEdges(const Coordinate& lookup, int source,
+                   int target, int edgeLength,
+                   Coordinate& result, MapperContext & ctx) const
 {
     int from = lookup.getStart();
     int to   = lookup.getStop();
@@ -331,12 +653,12 @@ bool Kraken::FindWithEdges(const Coordinate& lookup, const string & source,
     FILE_LOG(logDEBUG2) << "Mapping (left): ";
     Coordinate s, resLeft;
     s.set(lookup.getChr(), true, from, min(from + edgeLength, to));
-    bool bLeft = Find(s, source, target, resLeft);
+    bool bLeft = Find(s, source, target, resLeft, ctx);
 
     FILE_LOG(logDEBUG3) << "Mapping (right): ";
     Coordinate resRight;
     s.set(lookup.getChr(), true,  max(to - edgeLength, from), to);
-    bool bRight = Find(s, source, target, resRight);
+    bool bRight = Find(s, source, target, resRight, ctx);
 
     if (!bLeft && !bRight) {
       FILE_LOG(logDEBUG2) << "failed left and right mapping ";
@@ -380,11 +702,96 @@ bool Kraken::FindWithEdges(const Coordinate& lookup, const string & source,
     return true;
 }
 
+bool Kraken::FindWithAgreeingEdges(const Coordinate& lookup, int source, int target, int edgeLength,
+                                   Coordinate& result, MapperContext& ctx) const
+{
+  int from = min(lookup.getStart(), lookup.getStop());
+  int to   = max(lookup.getStart(), lookup.getStop());
+  // Edges are mapped on the forward strand, the strand of the lookup is applied to the result
+  Coordinate s, resLeft, resRight;
+  s.set(lookup.getChr(), true, from, min(from + edgeLength, to));
+  if (!Find(s, source, target, resLeft, ctx)) {
+    FILE_LOG(logDEBUG2) << "Left edge not mapped";
+    return false;
+  }
+  s.set(lookup.getChr(), true, max(to - edgeLength, from), to);
+  if (!Find(s, source, target, resRight, ctx)) {
+    FILE_LOG(logDEBUG2) << "Right edge not mapped";
+    return false;
+  }
+  if (resLeft.getChr() != resRight.getChr() || resLeft.isReversed() != resRight.isReversed()) {
+    FILE_LOG(logDEBUG2) << "Edges disagree on chromosome or strand";
+    return false;
+  }
+  // On the reverse strand the left edge lands after the right one
+  int start = (resLeft.isReversed() ? resRight.getStart() : resLeft.getStart());
+  int stop  = (resLeft.isReversed() ? resLeft.getStop()  : resRight.getStop());
+  if (stop < start) {
+    FILE_LOG(logDEBUG2) << "Edges are mapped out of order";
+    return false;
+  }
+  // The region between the edges stands in for the aligned lookup, so it has to be about as long
+  const int MAX_SPAN_FACTOR = 2;
+  long long span = (long long)stop - start + 1;
+  long long lookupLen = (long long)to - from + 1;
+  if (span > m_params.getMapSizeLimit() || span > MAX_SPAN_FACTOR*lookupLen || MAX_SPAN_FACTOR*span < lookupLen) {
+    FILE_LOG(logDEBUG2) << "Edges are mapped " << span << " bases apart for a lookup of " << lookupLen;
+    return false;
+  }
+  result.set(resLeft.getChr(), !resLeft.isReversed(), start, stop);
+  if (lookup.isReversed()) {
+    result.setOrient(resLeft.isReversed());
+  }
+  return true;
+}
+
+bool Kraken::MapsByEdges(const Coordinate & lookup) const
+{
+  // Lookups too long to be aligned in full are left to fail in Refine as without the edge policy
+  int threshold = m_params.getEdgeThreshold();
+  return (threshold > 0 && lookup.findLength() > threshold && 2*m_params.getEdgeLength() < threshold
+          && lookup.findLength() <= m_params.getTransSizeLimit());
+}
+
+bool Kraken::MapItemBatch(const svec<Coordinate> & lookups, int source, int target,
+                          svec< svec<Coordinate> > & candidates) const
+{
+  svec<Coordinate> batch;
+  svec<int> inBatch;
+  for (int i=0; i<lookups.isize(); i++) {
+    if (!MapsByEdges(lookups[i])) {
+      batch.push_back(lookups[i]);
+      inBatch.push_back(i);
+    }
+  }
+  svec< svec<Coordinate> > batchCandidates;
+  bool mapped = MapBatch(batch, source, target, batchCandidates);
+  candidates.clear();
+  candidates.resize(lookups.isize());
+  for (int i=0; i<inBatch.isize(); i++)
+    swap(candidates[inBatch[i]], batchCandidates[i]);
+  return mapped;
+}
+
+bool Kraken::RefineItem(const Coordinate & lookup, int source, int target,
+                        const svec<Coordinate> & candidates, Coordinate & result, MapperContext & ctx) const
+{
+  if (MapsByEdges(lookup)) {
+    bool agreed = FindWithAgreeingEdges(lookup, source, target, m_params.getEdgeLength(), result, ctx);
+    ctx.CountEdgeMap(agreed);
+    if (agreed) { return true; }
+    result = Coordinate();
+    return Find(lookup, source, target, result, ctx);
+  }
+  return Refine(lookup, source, target, candidates, result, ctx);
+}
+
 bool Kraken::Find(const Coordinate & lookup, 
-               const string & source, const string & target, Coordinate & result)
+               int source, int target, Coordinate & result,
+               MapperContext & ctx) const
 {
-  Route route;
-  if(! m_router.FindRoute(route, source, target, *this)) {
+  const Route & route = Router().FindRoute(source, target);
+  if (route.IsInvalid()) {
     FILE_LOG(logDEBUG2) << "NO route!";
     return false;
   }
@@ -394,34 +801,78 @@ bool Kraken::Find(const Coordinate & lookup,
     FILE_LOG(logDEBUG2) << "Mapping failed!!!";
     return false;
   }
-  
+  return Refine(lookup, source, target, results, result, ctx);
+}
+
+bool Kraken::Refine(const Coordinate & lookup, int source, int target,
+                    const svec<Coordinate> & candidates, Coordinate & result, MapperContext & ctx) const
+{
+  if (source < 0 || target < 0 || source >= GenomeCount() || target >= GenomeCount()) {
+    FILE_LOG(logDEBUG2) << "Unknown genome!";
+    return false;
+  }
+  svec<Coordinate> results = candidates;
+  int n = results.isize();
+  svec<CandidateScore> scores;
+  scores.resize(n);
+
+  // Candidates are scored by up to candidateThreads threads. Once a candidate reaches the 
+  // dominant ratio, the ones after it are cancelled and ignored even if they finished, so 
+  // the outcome does not depend on the number of threads or their timing.
+  std::atomic<int> dominant(n);
+  std::atomic<int> next(0);
+  double dominantRatio = m_params.getDominantRatio();
+  auto worker = [&](MapperContext & c) {
+    for (int i=next++; i<n; i=next++) {
+      c.SetCandidate(&dominant, i);
+      if (c.Cancelled()) { continue; }
+      CandidateScore & s = scores[i];
+      s.ok = RoughMap(lookup, source, target, c.SourceSeq(), s.window, 
+                      s.maxPos, s.maxVal, s.len, results[i], c);
+      if (!s.ok) { s.window.reset(); continue; }
+      s.ctx = &c;
+      if (dominantRatio > 0 && s.maxVal >= dominantRatio*c.SourceSeq().isize()) {
+        int d = dominant.load();
+        while (i < d && !dominant.compare_exchange_weak(d, i)) {}
+      }
+    }
+    c.SetCandidate(NULL, 0);
+  };
+  int threads = min(m_params.getCandidateThreads(), n);
+  if (threads <= 1) {
+    worker(ctx);
+  } else {
+    ctx.Worker(threads-2);  // Helper contexts are set up before the helpers look them up
+    ctx.Helpers().Run(threads, [&](int t) { worker(t == 0 ? ctx : ctx.Worker(t-1)); });
+  }
+
+  int best = -1;
   int bestMaxPos=0, bestLen=0;
   float bestMaxVal=0;
-  DNAVector sourceSeq, bestDestSeq; 
-  for(int i=0; i<results.isize(); i++) {
-    DNAVector targetSeq; 
-    int maxPos=-1, len=-1;
-    float maxVal=.0;
-    if(RoughMap(lookup, source, target, 
-                 sourceSeq, targetSeq, maxPos, 
-                 maxVal, len, results[i])) {
-      if(maxVal>bestMaxVal) {
-        bestMaxVal  = maxVal;
-        bestMaxPos  = maxPos;
-        bestLen     = len;
-        bestDestSeq = targetSeq;
-        result      = results[i];
-      }
+  int last = min(n-1, dominant.load());
+  for(int i=0; i<=last; i++) {
+    if(scores[i].ok && scores[i].maxVal>bestMaxVal) {
+      best        = i;
+      bestMaxVal  = scores[i].maxVal;
+      bestMaxPos  = scores[i].maxPos;
+      bestLen     = scores[i].len;
+      result      = results[i];
     }
   }
   if(bestLen==0) { return false; } 
+  if(last < n-1) {
+    FILE_LOG(logDEBUG2) << "Candidate " << last << " dominates, skipped " << n-1-last << " candidates";
+  }
+
+  // The helpers are done, so the best candidate's sequences are read in place
+  const DNAVector & sourceSeq = scores[best].ctx->SourceSeq();
+  const DNAView bestDest = scores[best].window->View();
 
   int slack=12;
   if (bestMaxPos-slack < 0) { slack = bestMaxPos; }
   FILE_LOG(logDEBUG3) << "Slack for finer alignment: " << slack;
-  DNAVector trueDestination;
-  trueDestination.SetToSubOf(bestDestSeq, bestMaxPos-slack, bestLen+2*slack);
-  bool exhaustAligned = ExhaustAlign(trueDestination, sourceSeq, slack, result);
+  DNAView trueDestination = bestDest.Sub(bestMaxPos-slack, bestLen+2*slack);
+  bool exhaustAligned = ExhaustAlign(trueDestination, sourceSeq, slack, result, ctx);
 
   // Adjust overflow if required 
   if(exhaustAligned && m_params.isOverflowAdjust()) {
@@ -430,8 +881,7 @@ bool Kraken::Find(const Coordinate & lookup,
       FILE_LOG(logDEBUG2) << "Adjusting beginning of mapped region for overflow: " << result.getStart() << " -> 0 ";
       result.setStart(0);           
     }
-    const vecDNAVector & destGenome = m_seq[Genome(target)].DNA();
-    int destChrSize = destGenome(result.getChr()).isize();
+    int destChrSize = m_seq[target].ChromosomeSize(result.getChr());
     if(result.getStop() > destChrSize-1) { 
       FILE_LOG(logDEBUG2) << "Adjusting end of mapped region for overflow: " << result.getStop() << " -> " << destChrSize; 
       result.setStop(destChrSize-1); 
@@ -441,26 +891,31 @@ bool Kraken::Find(const Coordinate & lookup,
   return exhaustAligned; 
 }
  
-bool Kraken::RoughMap(const Coordinate& lookup, const string& source,
-                   const string& target, DNAVector& sourceSeq, DNAVector& targetSeq, 
-                   int& maxPos, float& maxVal, int& len, Coordinate& result) {
-  int sourceIndex = Genome(source);
-  int targetIndex = Genome(target);
-  const vecDNAVector & sourceGenome = m_seq[sourceIndex].DNA();
-  const vecDNAVector & targetGenome = m_seq[targetIndex].DNA();
+bool Kraken::RoughMap(const Coordinate& lookup, int sourceIndex,
+                   int targetIndex, DNAVector& sourceSeq, std::shared_ptr<TargetWindow>& window, 
+                   int& maxPos, float& maxVal, int& len, Coordinate& result,
+                   MapperContext& ctx) const {
+  const GenomeSeq & sourceGenome = m_seq[sourceIndex];
+  const GenomeSeq & targetGenome = m_seq[targetIndex];
   
-  FILE_LOG(logDEBUG3) << sourceGenome.Name(0);
-  FILE_LOG(logDEBUG3) << targetGenome.Name(0);
+  FILE_LOG(logDEBUG3) << sourceGenome.Name();
+  FILE_LOG(logDEBUG3) << targetGenome.Name();
   FILE_LOG(logDEBUG3) << "Check."; 
   FILE_LOG(logDEBUG3) << "Raw Origin: "
                       << lookup.toString('\t')
                       << "Raw Destination:  " 
                       << result.toString('\t');  
   if(!sourceGenome.SetSequence(lookup, sourceSeq)) { return false; }
-  result.setStart(result.getStart() - 5000);
-  result.setStop(result.getStop() + 5000);
-  if(!SetSequence(targetGenome, result, targetSeq)) { return false; }
-  bool successAlign = RoughAlign(targetSeq, sourceSeq, maxPos, maxVal, len, result);  
+  int padding = WindowPadding(lookup, result);
+  result.setStart(result.getStart() - padding);
+  result.setStop(result.getStop() + padding);
+  // The window's sequence is extracted in place and read from there on, it is never copied.
+  // Reverse strand windows are kept as extracted and read through a reversed view.
+  window = ctx.NextWindow();
+  window->reversed = result.isReversed();
+  if(!SetSequence(targetGenome, result, window->seq)) { return false; }
+  const DNAView targetSeq = window->View();
+  bool successAlign = RoughAlign(targetSeq, sourceSeq, maxPos, maxVal, len, result, ctx);  
   if(!successAlign) { return false; }
   FILE_LOG(logDEBUG2) << "Final Origin: " 
                       << lookup.toString('\t')
@@ -472,55 +927,95 @@ bool Kraken::RoughMap(const Coordinate& lookup, const string& source,
   return true;
 }
 
-bool Kraken::SetSequence(const vecDNAVector& genome, Coordinate& coords, DNAVector& resultSeq) {
-  if(!genome.HasChromosome(coords.getChr())) { 
+int Kraken::WindowPadding(const Coordinate& lookup, const Coordinate& candidate) const {
+  const int DEFAULT_PADDING = 5000;
+  const int MIN_PADDING     = 256;
+  if(!m_params.isAdaptiveWindow()) { return DEFAULT_PADDING; }
+  // The candidate spans the synteny blocks around the lookup, so the difference in length is 
+  // what the blocks gained or lost in between and bounds how far off the lookup can be placed
+  int lookupLen = lookup.getStop() - lookup.getStart() + 1;
+  int candidateLen = candidate.getStop() - candidate.getStart() + 1;
+  int padding = max(lookupLen, abs(candidateLen - lookupLen));
+  return min(DEFAULT_PADDING, max(MIN_PADDING, padding));
+}
+
+void Kraken::BlockLayout(int sourceLen, MultiSizeXCorr& xc, int& blockLen, int& blockOverlap) const {
+  const int BLOCK_LIMIT = 163840;
+  const int MIN_BLOCK   = 1024;
+  // Fixed blocks overlap by a tenth, also used for sources too long for adaptive blocks below the limit
+  blockLen     = BLOCK_LIMIT;
+  blockOverlap = BLOCK_LIMIT/10;
+  if(!m_params.isAdaptiveWindow() || 2*sourceLen > BLOCK_LIMIT) { return; }
+  // Adaptive blocks overlap by the source so that no placement straddles two, and are at least twice
+  // the source so that each advances by at least the source. They are the longest blocks that xc.Size 
+  // puts into the same transform as the shortest one, as found by asking it (it grows with the lengths).
+  int size = xc.Size(sourceLen, max(2*sourceLen, MIN_BLOCK));
+  int lo   = max(2*sourceLen, MIN_BLOCK);
+  int hi   = BLOCK_LIMIT;
+  while(lo < hi) {
+    int mid = lo + (hi - lo + 1)/2;
+    if(xc.Size(sourceLen, mid) == size) { lo = mid;     }
+    else                                { hi = mid - 1; }
+  }
+  blockLen     = lo;
+  blockOverlap = sourceLen;
+}
+
+bool Kraken::SetSequence(const GenomeSeq& genome, Coordinate& coords, DNAVector& resultSeq) const {
+  if(!ClampToChromosome(genome, coords)) { return false; }
+  return genome.Extract(coords.getChr(), coords.getStart(), coords.getStop()-coords.getStart()+1, resultSeq);
+}
+
+bool Kraken::ClampToChromosome(const GenomeSeq& genome, Coordinate& coords) const {
+  int chrSize = genome.ChromosomeSize(coords.getChr());
+  if(chrSize == -1) { 
     FILE_LOG(logWARNING) << "Check Genome data! - Chromosome: "  << coords.getChr() 
-                         << " was not found in the given fasta file";
+                         << " was not found in the given genome file";
     return false; 
   }   
-  int size = abs(coords.getStop() - coords.getStart());
   if(coords.getStart()<0) { coords.setStart(0); }
   if(coords.getStop()<0)  { coords.setStop(0); }
-  if(coords.getStart()+1 > genome(coords.getChr()).isize()) {
+  if(coords.getStart()+1 > chrSize) {
     FILE_LOG(logDEBUG3) << "Limiting initial start to fit in with chromosome."; 
-    coords.setStart(genome(coords.getChr()).isize()-1);
+    coords.setStart(chrSize-1);
   }
-  if(coords.getStop()+1 > genome(coords.getChr()).isize()) {
+  if(coords.getStop()+1 > chrSize) {
     FILE_LOG(logDEBUG3) << "Limiting initial stop to fit in with chromosome."; 
-    coords.setStop(genome(coords.getChr()).isize()-1);
+    coords.setStop(chrSize-1);
   }
-  bool set = resultSeq.SetToSubOf(genome(coords.getChr()), coords.getStart(), coords.getStop()-coords.getStart()+1);
-  if (coords.isReversed())
-    resultSeq.ReverseComplement();
-  return set;
+  return true;
 }
 
-bool Kraken::RoughAlign(DNAVector& q, DNAVector& t, 
-                      int& maxPos, float& maxVal, int& len, Coordinate& result) {
+bool Kraken::RoughAlign(const DNAView& q, const DNAVector& t, 
+                      int& maxPos, float& maxVal, int& len, Coordinate& result,
+                      MapperContext& ctx) const {
 
-  const int BLOCK_LIMIT   = 163840;
-  const int BLOCK_OVERLAP = BLOCK_LIMIT/10;
   if(t.isize() > m_params.getTransSizeLimit()) {  
       FILE_LOG(logWARNING) << "Requested region to be mapped: " 
                            << t.isize()<<" is too large";
       return false;
   }
+  int blockLen, blockOverlap;
+  BlockLayout(t.isize(), ctx.XC(), blockLen, blockOverlap);
 
-  DNAVector qBlock  = q;
   int currStart     = 0;
   int currLen       = 0;
   do {
-    currLen = min(BLOCK_LIMIT, q.isize()-currStart);
-    qBlock.SetToSubOf(q, currStart, currLen);
-    int size = m_xc.Size(t.isize(), qBlock.isize());
+    if(ctx.Cancelled()) {
+      FILE_LOG(logDEBUG2) << "Cancelled as an earlier candidate dominates";
+      return false;
+    }
+    currLen = min(blockLen, q.isize()-currStart);
+    DNAView qBlock = q.Sub(currStart, currLen);
+    int size = ctx.XC().Size(t.isize(), qBlock.isize());
     float maxVal_temp;
     int maxPos_temp;
-    Ccorrelate(qBlock, t, size, maxVal_temp, maxPos_temp);
+    Ccorrelate(qBlock, t, size, maxVal_temp, maxPos_temp, ctx);
     if(maxVal_temp > maxVal) { 
       maxVal = maxVal_temp;
       maxPos = currStart + maxPos_temp;
     }
-    currStart += BLOCK_LIMIT - min(t.isize(), BLOCK_OVERLAP);
+    currStart += blockLen - min(t.isize(), blockOverlap);
     FILE_LOG(logDEBUG2) << "q=" << qBlock.isize() << " t=" << t.isize() << " size=" << size;
     FILE_LOG(logDEBUG2) << "Remaining number of bases= " << q.isize()-currStart;
   } while(currStart < q.isize());
@@ -564,14 +1059,16 @@ bool Kraken::RoughAlign(DNAVector& q, DNAVector& t,
   return true;
 }
 
-void Kraken::Ccorrelate(const DNAVector& q, const DNAVector& t, double size, 
-                        float& maxValOut, int& maxPosOut) {
+void Kraken::Ccorrelate(const DNAView& q, const DNAVector& t, double size, 
+                        float& maxValOut, int& maxPosOut, MapperContext& ctx) const {
 
-  CCSignal sigsource, sigtarget;      
-  sigsource.SetSequence(t, size);
-  sigtarget.SetSequence(q, size);
-  svec<float> signal;
-  m_xc.CrossCorrelate(signal, sigtarget, sigsource);
+  // Same transform sizes recur for most items, so the signals and output keep their storage between calls
+  XCorrBuffers & buffers = ctx.Buffers((int)size);
+  buffers.source.SetSequence(t, size);
+  buffers.target.SetSequence(q.Materialize(ctx.BlockSeq()), size);
+  svec<float> & signal = buffers.signal;
+  signal.clear();  // Keeps the capacity
+  ctx.XC().CrossCorrelate(signal, buffers.target, buffers.source);
   
   svec<float>::iterator it = max_element(signal.begin(), signal.end());
   maxValOut = *it;
@@ -580,33 +1077,48 @@ void Kraken::Ccorrelate(const DNAVector& q, const DNAVector& t, double size,
   
 }
 
-bool Kraken::ExhaustAlign(DNAVector& trueDestination, DNAVector& source,
-                          int slack, Coordinate& result) {
+bool Kraken::ExhaustAlign(const DNAView& trueDestination, const DNAVector& source,
+                          int slack, Coordinate& result, MapperContext& ctx) const {
   Cola aligner;
   int bound;
   // Optimal align with a band of slack+5% of the query sequence size using Smithwaterman-gap-affine
   bound=min(source.size()/20, 20)+slack; 
-  AlignmentCola pAlign =  aligner.createAlignment(source, trueDestination, 
+
+  // The banded aligner scores as cola's SWGA with the parameters below (see TestBandedAligner), so the
+  // score, the offsets and the aligned bases of either side come from it, in linear memory and vectorised
+  BandedScore aligned = ctx.Aligner().Align(source, trueDestination, bound);
+
+  // The cover check needs no traceback: the source bases the banded alignment spans are the ones cola
+  // aligns (see TestExhaustAlign), so candidates failing it are rejected before the full alignment
+  double ratio = (double)aligned.QueryAligned()/(double)source.isize();
+  if (ratio<m_params.getMinAlignCover()) {
+    FILE_LOG(logDEBUG1) << "Rejecting...based on banded alignment cover " << ratio << " - Code7";
+    ctx.CountPrescreenReject();
+    return false;
+  }
+  // The p-value, the identity and the alignment length are read off the aligned bases, i.e. they need 
+  // cola's traceback, for which the candidate copies its part of the window
+  AlignmentCola pAlign =  aligner.createAlignment(source, trueDestination.Materialize(ctx.DestSeq()), 
                              AlignerParams(bound, SWGA, -5, -2, -1));
 
   FILE_LOG(logDEBUG3) << endl << pAlign.toString(100);
  
-  double ratio = (double)pAlign.getTargetBaseAligned()/(double)source.isize();
-  if (ratio<m_params.getMinAlignCover() || pAlign.calcPVal()>m_params.getPValThresh() || pAlign.calcIdentityScore()<m_params.getMinIdent()) {
+  if (pAlign.calcPVal()>m_params.getPValThresh() || pAlign.calcIdentityScore()<m_params.getMinIdent()) {
     FILE_LOG(logDEBUG1) << "Rejecting...based on exhaustive alignment - Code7";
     return false;
   }
     
   // Adjust beginning and end in accordance with alignment results
   int adjustBegin, adjustEnd; 
+  // In cola's terms the source is the target and the destination the query
   if(m_params.isLocalAlignAdjust()) {
-    adjustBegin = pAlign.getQueryOffset() - slack;
-    adjustEnd   = pAlign.getQueryLength() - 2*slack - adjustBegin - pAlign.getQueryBaseAligned();
+    adjustBegin = aligned.targetStart - slack;
+    adjustEnd   = trueDestination.isize() - 2*slack - adjustBegin - aligned.TargetAligned();
   } else {
-    adjustBegin = pAlign.getQueryOffset() - slack - pAlign.getTargetOffset();
+    adjustBegin = aligned.targetStart - slack - aligned.queryStart;
 //  Full formula  adjustEnd   = (pAlign.getQueryLength() -2*slack - pAlign.getQueryOffset() + slack - pAlign.getAlignmentLen()) 
 //                  - (pAlign.getTargetLength() - p.Align.getTargetOffset() - pAlign.getAlignmentLen());  
-    adjustEnd   = pAlign.getQueryLength() - 2*slack - adjustBegin - max(pAlign.getTargetLength(), pAlign.getAlignmentLen());
+    adjustEnd   = trueDestination.isize() - 2*slack - adjustBegin - max(source.isize(), pAlign.getAlignmentLen());
   } 
   FILE_LOG(logDEBUG2) << "Adjust begin: " << adjustBegin << " Adjust end: " << adjustEnd;
 
@@ -621,97 +1133,129 @@ bool Kraken::ExhaustAlign(DNAVector& trueDestination, DNAVector& source,
   return true;
 }
 
-int Kraken::Index(const string & source, const string & target) {
+int Kraken::Index(const string & source, const string & target) const {
   GenomeWideMap tmp;
   tmp.Set(source, target, 0.);
 
-  int i = (int)BinSearch(m_maps, tmp);
-  return i;
+  return SortedIndex(m_maps, tmp);
 }
 
-int Kraken::Genome(const string & name)
+int Kraken::Genome(const string & name) const
 {
   GenomeSeq tmp(name);
 
-  int i = (int)BinSearch(m_seq, tmp);
-  return i;
+  return SortedIndex(m_seq, tmp);
 }
 
-bool RouteFinder::FindRoute(Route & out, const string & source, const string & target,  Kraken & rum)
+// Cost of a route: the distance over non-preferred maps comes first, so that preferred maps
+// are taken whenever they lead to the target, then the total distance and the number of hops
+struct RouteCost
 {
-  int iT = rum.Genome(source);
-  int iQ = rum.Genome(target);
-  int index = iQ + rum.GenomeCount() * iT;
-  int i;
-
-  Route & r = m_routes[index];
-  if (r.IsInvalid()) {
-    FILE_LOG(logDEBUG2) << "NO possible route from " << source << " to " << " target";
-    return false;
+  RouteCost(double p = 0., double t = 0., int h = 0): plain(p), total(t), hops(h) {}
+
+  bool operator < (const RouteCost & c) const {
+    if (plain != c.plain) 
+      return (plain < c.plain);
+    if (total != c.total) 
+      return (total < c.total);
+    return (hops < c.hops);
   }
-  if (r.GetCount() > 0) {
-    out = r;
-    return true;
+  RouteCost operator + (const RouteCost & c) const {
+    return RouteCost(plain + c.plain, total + c.total, hops + c.hops);
   }
-  svec<string> path;
-  svec<string> final;
-  path.reserve(100);
 
-  FILE_LOG(logDEBUG1) << "Finding path from " << source << " to " << target;
-  path.push_back(source);
-  FindRecursive(final, path, target, rum);
-  
-  if (final.isize() == 1) {
-    FILE_LOG(logDEBUG1) << "NO possible route from " << source << " to " << " target";
-    r.SetInvalid();
-    return false;
-  }
-  
-  for (i=1; i<final.isize(); i++) {
-    FILE_LOG(logDEBUG1) << "path: " << final[i-1] << " -> " << final[i];
-    r.Add(final[i-1], final[i]);
-  }
-  
-  return true;
-}
+  double plain;
+  double total;
+  int hops;
+};
 
-bool RouteFinder::FindRecursive(svec<string> & final, svec<string> & path, const string & target, Kraken & rum) const
+void RouteFinder::Build(const Kraken & rum)
 {
-  string last = path[path.isize()-1];
-  
-  if (last == target)
-    return true;
-
-  int index = rum.Index(last, target);
-  if (index != -1) {
-    path.push_back(target);
-    FILE_LOG(logDEBUG2) << "**** Found it!!";
-    final = path;
-    return true;
-  }
-  bool b = false;
-  for (int i=0; i<rum.GenomeCount(); i++) {
-    const string & sourceGenome = rum.GenomeName(i);
-    int index = rum.Index(last, sourceGenome);
-    if (index == -1)
+  int n = rum.GenomeCount();
+  m_count = n;
+  m_routes.clear();
+  m_routes.resize(n * n);
+
+  // Floyd-Warshall over the map distances, next[i*n+j] is the genome after i on the best route to j
+  svec<RouteCost> cost;
+  svec<int> next;
+  cost.resize(n * n);
+  next.resize(n * n);
+  int i, j, k;
+  for (i=0; i<n*n; i++)
+    next[i] = -1;
+  for (i=0; i<rum.m_maps.isize(); i++) {
+    const GenomeWideMap & m = rum.m_maps[i];
+    int from = rum.Genome(m.Origin());
+    int to   = rum.Genome(m.Destination());
+    if (from == -1 || to == -1 || from == to)
       continue;
-	    
-    bool bBad = false;
-    for (int j=0; j<path.isize(); j++) {
-      if (path[j] == sourceGenome) {
-	bBad = true;
-	break;
+    RouteCost c(m.IsPreferred() ? 0. : m.Distance(), m.Distance(), 1);
+    if (next[from*n + to] == -1 || c < cost[from*n + to]) {
+      cost[from*n + to] = c;
+      next[from*n + to] = to;
+    }
+  }
+  for (k=0; k<n; k++) {
+    for (i=0; i<n; i++) {
+      if (i == k || next[i*n + k] == -1)
+	continue;
+      for (j=0; j<n; j++) {
+	if (j == i || j == k || next[k*n + j] == -1)
+	  continue;
+	RouteCost c = cost[i*n + k] + cost[k*n + j];
+	if (next[i*n + j] == -1 || c < cost[i*n + j]) {
+	  cost[i*n + j] = c;
+	  next[i*n + j] = next[i*n + k];
+	}
       }
     }
-    if (bBad)
-      continue;
-    
-    path.push_back(sourceGenome);
-    b = FindRecursive(final, path, target, rum);
-    if (!b) {
-      path.resize(path.isize()-1);
+  }
+
+  for (i=0; i<n; i++) {
+    for (j=0; j<n; j++) {
+      if (i == j)
+	continue;
+      Route & r = m_routes[j + n * i];
+      if (next[i*n + j] == -1) {
+	FILE_LOG(logDEBUG1) << "NO possible route from " << rum.GenomeName(i) << " to " << rum.GenomeName(j);
+	r.SetInvalid();
+	continue;
+      }
+      for (k=i; k!=j; k=next[k*n + j]) {
+	int h = next[k*n + j];
+	FILE_LOG(logDEBUG1) << "path: " << rum.GenomeName(k) << " -> " << rum.GenomeName(h);
+	int map = rum.Index(rum.GenomeName(k), rum.GenomeName(h));
+	r.Add(k, h, map, rum.m_maps[map].Distance());
+      }
     }
-    
   }
-  return b;
 }
+
+const RouteFinder & Kraken::Router() const
+{
+  m_routesBuilt.Run([this]() { m_router.Build(*this); });
+  return m_router;
+}
+
+const Route & RouteFinder::FindRoute(int source, int target) const
+{
+  if (source < 0 || target < 0 || source >= m_count || target >= m_count || source == target)
+    return m_none;
+  return m_routes[target + m_count * source];
+}
+
+const Route & RouteFinder::FindRoute(const string & source, const string & target, const Kraken & rum) const
+{
+  int iT = rum.Genome(source);
+  int iQ = rum.Genome(target);
+  if (iT == -1 || iQ == -1) {
+    FILE_LOG(logDEBUG2) << "Unknown genome in route from " << source << " to " << target;
+    return m_none;
+  }
+  const Route & r = FindRoute(iT, iQ);
+  if (r.IsInvalid())
+    FILE_LOG(logDEBUG2) << "NO possible route from " << source << " to " << target;
+  return r;
+}
+
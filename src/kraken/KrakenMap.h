@@ -1,6 +1,9 @@
 #ifndef KRAKENMAP_H
 #define KRAKENMAP_H
 
+#include <atomic>
+#include <map>
+#include <memory>
 #include "ryggrad/src/base/Logger.h"
 #include "ryggrad/src/general/DNAVector.h"
 #include "ryggrad/src/base/FileParser.h"
@@ -8,12 +11,25 @@
 #include "ryggrad/src/general/AlignmentBlock.h"
 #include "../annotationQuery/AnnotationQuery.h"
 #include "KrakenParams.h"
-
+#include "PackedGenome.h"
+#include "LazyLoad.h"
+#include "SyntenyCache.h"
+#include "BandedAligner.h"
+#include "DNAView.h"
+#include "HelperPool.h"
+
+/**
+ * Synteny blocks between a source and a target genome. The blocks are either read
+ * right away (Read) or on first use from the file given to SetFile, through the
+ * binary sidecar of the file when it is up to date (see SyntenyCache).
+ */
 class GenomeWideMap
 {
 public:
   GenomeWideMap() {
     m_distance = 0.5;
+    m_flip = false;
+    m_preferred = false;
   }
 
   void Set(const string & source, const string & target, double distance = 0.5) {
@@ -23,7 +39,24 @@ public:
   }
 
   void Read(const string & fileName, const string & source, const string & target, bool flip, double distance = 0.5);
-  bool Map(const Coordinate& lookup, svec<Coordinate>& results, int mapSizeLimit);
+  /** Sets the file from which the blocks are read on first use, flip if the source is the query of the file */
+  void SetFile(const string & fileName, bool flip) {
+    m_fileName = fileName;
+    m_flip = flip;
+  }
+  /** Reads the blocks unless they have been read already */
+  void Load() const;
+  bool IsLoaded() const {return m_loader.IsDone();}
+
+  /** Maps lookup to the target genome, searching the blocks through their Eytzinger index if searchIndex is set */
+  bool Map(const Coordinate& lookup, svec<Coordinate>& results, int mapSizeLimit, bool searchIndex = true) const;
+
+  /**
+   * Maps all lookups at once, results[i] holds the regions for lookups[i] (empty if not found).
+   * The lookups are ordered internally and their blocks found in a single forward sweep over
+   * the blocks, which beats separate searches for batches as large as an annotation.
+   */
+  void MapBatch(const svec<Coordinate>& lookups, svec< svec<Coordinate> >& results, int mapSizeLimit) const;
 
   bool operator < (const GenomeWideMap & m) const {
     if (m_source != m.m_source) {
@@ -36,37 +69,67 @@ public:
     FILE_LOG(logDEBUG) << "T=" << m_source << " Q=" << m_target << endl;
   }
 
-  int GetBlockCount() const {return m_blocks.isize();}
-  const AlignmentBlock& GetBlock(int i) const {return  m_blocks[i];}
+  int GetBlockCount() const {Load(); return m_blocks.Size();}
+  SyntenyBlock GetBlock(int i) const {Load(); return  m_blocks.Block(i);}
 
   const string & Destination() const {return m_target;}
   const string & Origin() const {return m_source;}
   double Distance() const {return m_distance;}
+  bool IsPreferred() const {return m_preferred;}
+  void SetPreferred(bool preferred) {m_preferred = preferred;}
 private:
-  void SetAnchors(const Coordinate & lookup, const AlignmentBlock& beginBlock, 
-                  const AlignmentBlock& endBlock, int startExtend, int stopExtend,
-                  Coordinate & result); 
-  void MergeBlocks();
-
+  /** Sets the mapped region from the blocks with indexes begin and end */
+  void SetAnchors(const Coordinate & lookup, int begin, int end, 
+                  int startExtend, int stopExtend, Coordinate & result) const; 
+  /** Maps lookup given the lower bounds of its start and stop among the blocks of chromosome chrom */
+  bool MapBlocks(const Coordinate & lookup, int chrom, int startIndex, int stopIndex,
+                 svec<Coordinate>& results, int mapSizeLimit) const;
+  string BlockString(int i) const;
+
+  /** Lookup of a batch, ordered by chromosome id and start */
+  struct BatchItem {
+    int chrom;
+    int start;
+    int index;  /// Position of the lookup in the batch
+    bool operator < (const BatchItem & b) const {
+      if (chrom != b.chrom) 
+        return (chrom < b.chrom);
+      if (start != b.start) 
+        return (start < b.start);
+      return (index < b.index);
+    }
+  };
 
   string m_source;
   string m_target;
   double m_distance;
-  svec<AlignmentBlock> m_blocks;
+  string m_fileName;                     /// File containing the blocks
+  bool m_flip;                           /// Whether source and target are swapped with regards to the file
+  bool m_preferred;                      /// Whether routes should go through this map where possible
+  LazyLoad m_loader;                     /// Guards reading the blocks on first use
+  mutable SyntenyBlockSet m_blocks;      /// Blocks sorted by their source (target side) coordinates
 };
 
 
 
+/**
+ * Sequence of a genome, either read from FASTA into memory or 
+ * memory mapped from a packed genome file (see PackedGenome).
+ * The sequence is read right away (Read) or on first use from the file given to SetFile.
+ */
 class GenomeSeq
 {
 public:
   GenomeSeq() {}
   GenomeSeq(const string &n) {m_name = n;}
 
-  void Read(const string & fileName, const string & genome) {
-    m_dna.Read(fileName);
-    m_name = genome;
-  }
+  /** Reads a FASTA file, or maps the file if it is a packed genome */
+  void Read(const string & fileName, const string & genome);
+  /** Sets the file from which the sequence is read on first use */
+  void SetFile(const string & fileName) {m_fileName = fileName;}
+  /** Reads the sequence unless it has been read already */
+  void Load() const;
+  bool IsLoaded() const {return m_loader.IsDone();}
 
   void SetName(const string & name) {
     m_name = name;
@@ -76,17 +139,40 @@ public:
     return (m_name < s.m_name);
   }
 
-  const vecDNAVector & DNA() const {return m_dna;}
+  /** Note: only holds the sequences of genomes read from FASTA */
+  const vecDNAVector & DNA() const {Load(); return m_dna;}
   const string & Name() const {return m_name;}
+  bool IsPacked() const {Load(); return m_packed.IsOpen();}
+
+  int ChromosomeCount() const;
+  /** Name of the i-th chromosome as used in coordinates */
+  string ChromosomeName(int i) const;
+  int ChromosomeSize(int i) const;
+  bool HasChromosome(const string & chr) const;
+  /** Size of the chromosome with the given name, -1 if it does not exist */
+  int ChromosomeSize(const string & chr) const;
+
+  /** Sets seq to len bases of chromosome chr from start on, the range must lie within the chromosome */
+  bool Extract(const string & chr, int start, int len, DNAVector & seq) const;
+  /** Sets seq to the sequence of coords (reverse complemented for reverse orientation) */
+  bool SetSequence(const Coordinate & coords, DNAVector & seq) const;
   
 private:
-  vecDNAVector m_dna;
+  mutable vecDNAVector m_dna;
+  mutable PackedGenome m_packed;
   string m_name;
+  string m_fileName;   /// FASTA or packed file holding the sequence
+  LazyLoad m_loader;   /// Guards reading the sequence on first use
 };
 
 
 //=========================================================
 
+/**
+ * Hops between two genomes, each hop given by the indices of its genomes
+ * and of the pairwise map to go through, so that no names are looked up
+ * while mapping.
+ */
 class Route
 {
 public:
@@ -96,46 +182,177 @@ public:
   }
 
   int GetCount() const {return m_source.isize();}
-  const string & Origin(int i) const {return m_source[i];}
-  const string & Destination(int i)  const {return m_target[i];}
+  /** Genome index of the source of hop i */
+  int Origin(int i) const {return m_source[i];}
+  /** Genome index of the target of hop i */
+  int Destination(int i)  const {return m_target[i];}
+  /** Index of the map of hop i */
+  int Map(int i) const {return m_map[i];}
+  double Distance() const {return m_dist;}
 
   bool IsInvalid() const {return m_invalid;}
   void SetInvalid() {m_invalid = true;}
 
-  void Add(const string & source, const string & target, double dist = 0.) {
+  void Add(int source, int target, int map, double dist = 0.) {
     m_source.push_back(source);
     m_target.push_back(target);
+    m_map.push_back(map);
     m_dist += dist;
   }
 
 private:
  
-  svec<string> m_source;
-  svec<string> m_target;
+  svec<int> m_source;
+  svec<int> m_target;
+  svec<int> m_map;
   double m_dist;
   bool m_invalid;
-
-
 };
 
 
 class Kraken;
 
+/**
+ * Holds the routes between every pair of genomes. The routes are all computed
+ * up front by Build, after which the table is immutable and handed out by const
+ * reference, so lookups from any number of threads need no lock. A route is the
+ * shortest path over the pairwise maps by summed map distance, where maps marked
+ * as preferred in the config are taken whenever they lead to the target.
+ */
 class RouteFinder
 {
 public:
-  RouteFinder() {}
+  RouteFinder(): m_routes(), m_count(0), m_none() {
+    m_none.SetInvalid();
+  }
   
-  void SetNumGenomes(int genomes) {
-    m_routes.resize(genomes * genomes);
+  /** Computes the routes between all genome pairs (Floyd-Warshall), to be called once all maps have been allocated */
+  void Build(const Kraken & rum);
+
+  /** Route between the given genome indices, invalid if there is none */
+  const Route & FindRoute(int source, int target) const;
+  /** Same by genome name, invalid if either genome is unknown */
+  const Route & FindRoute(const string & source, const string & target, const Kraken & rum) const;
+
+private:
+  svec<Route> m_routes;   /// Route from genome i to genome j at j + m_count*i
+  int m_count;            /// Number of genomes when the routes were built
+  Route m_none;           /// Returned for unknown genomes
+};
+
+
+//=========================================================
+
+/** Signals and output buffer of a cross-correlation of one transform size */
+struct XCorrBuffers
+{
+  CCSignal source;
+  CCSignal target;
+  svec<float> signal;
+};
+
+/**
+ * Padded destination window of a rough alignment, extracted on the forward strand. It is 
+ * kept with its candidate so that the best one is read in place for the exhaustive alignment.
+ */
+struct TargetWindow
+{
+  TargetWindow(): reversed(false), seq() {}
+
+  /** The window on its strand, reverse complemented base by base on access if reversed */
+  DNAView View() const { return DNAView(seq, reversed); }
+
+  bool reversed;       /// Whether the window is read on the reverse strand
+  DNAVector seq;       /// Forward strand sequence of the window, read through View
+};
+
+/**
+ * Mutable state used by a Kraken lookup (cross-correlator, FFT buffers and sequence scratch space).
+ * Kraken itself is not modified by the lookups, so one loaded Kraken object can serve
+ * any number of threads as long as each thread uses its own context.
+ */
+class MapperContext
+{
+public:
+  MapperContext(): m_xc(), m_sourceSeq(), m_destSeq(), m_blockSeq(),
+                   m_buffers(), m_bufferHits(0), m_bufferMisses(0),
+                   m_windows(), m_nextWindow(0), m_aligner(),
+                   m_prescreenRejects(0), m_edgeMaps(0), m_edgeFallbacks(0), m_workers(), m_helpers(), m_dominant(NULL), m_candidate(0) {}
+
+  MultiSizeXCorr & XC()        { return m_xc;            }
+  DNAVector & SourceSeq()      { return m_sourceSeq;     }
+  DNAVector & DestSeq()        { return m_destSeq;       }
+  DNAVector & BlockSeq()       { return m_blockSeq;      }
+  BandedAligner & Aligner()    { return m_aligner;       }
+
+  void CountPrescreenReject()        { m_prescreenRejects++;     }
+  long long PrescreenRejects() const { return m_prescreenRejects; }
+  /** Counts a long lookup mapped by its edges, or aligned in full if they disagreed */
+  void CountEdgeMap(bool agreed)     { (agreed ? m_edgeMaps : m_edgeFallbacks)++; }
+  long long EdgeMaps() const         { return m_edgeMaps;         }
+  long long EdgeFallbacks() const    { return m_edgeFallbacks;    }
+
+  /** Context of the i-th helper thread scoring candidates of a lookup made with this context */
+  MapperContext & Worker(int i) {
+    while (m_workers.isize() <= i)
+      m_workers.push_back(std::make_shared<MapperContext>());
+    return *m_workers[i];
+  }
+  /** Threads running the helper contexts, kept across lookups */
+  HelperPool & Helpers() {
+    if (!m_helpers)
+      m_helpers = std::make_shared<HelperPool>();
+    return *m_helpers;
+  }
+
+  /** 
+   * Marks the context as working on candidate index of a lookup whose first dominant candidate 
+   * is tracked by dominant, NULL when not scoring candidates.
+   */
+  void SetCandidate(const std::atomic<int> * dominant, int index) {
+    m_dominant  = dominant;
+    m_candidate = index;
+  }
+  /** Whether an earlier candidate already dominates the current one, so it need not be finished */
+  bool Cancelled() const { return m_dominant != NULL && m_dominant->load() < m_candidate; }
+
+  /** Cross-correlation buffers for the given transform size, kept for reuse by later calls */
+  XCorrBuffers & Buffers(int size) {
+    std::map<int, XCorrBuffers>::iterator it = m_buffers.find(size);
+    if (it != m_buffers.end()) {
+      m_bufferHits++;
+      return it->second;
+    }
+    m_bufferMisses++;
+    return m_buffers[size];
   }
+  long long BufferHits() const;
+  long long BufferMisses() const;
 
-  bool FindRoute(Route & out, const string & source, const string & target, Kraken & rum);
+  /** 
+   * Window to be filled in place, replacing the oldest one. Its storage is reused unless the 
+   * old window is still held by a candidate.
+   */
+  std::shared_ptr<TargetWindow> NextWindow();
 
 private:
-  bool FindRecursive(svec<string> & final, svec<string> & path, const string & target, Kraken & rum) const;
-  
-  svec<Route> m_routes;
+  MultiSizeXCorr m_xc;         /// Cross-correlator holding the FFT buffers for the different transform sizes
+  DNAVector m_sourceSeq;       /// Sequence of the region being looked up
+  DNAVector m_destSeq;         /// Part of the best window for the exhaustive alignment, if it has to be copied
+  DNAVector m_blockSeq;        /// Block of the destination window whose signal is computed, if it has to be copied
+  std::map<int, XCorrBuffers> m_buffers;  /// Cross-correlation buffers by transform size
+  long long m_bufferHits;      /// Number of Buffers calls served by an existing size
+  long long m_bufferMisses;    /// Number of Buffers calls that had to set up a new size
+  svec< std::shared_ptr<TargetWindow> > m_windows;  /// Most recently used destination windows, for their storage
+  int m_nextWindow;            /// Slot of m_windows to be replaced next
+  BandedAligner m_aligner;     /// Banded aligner with the scoring of ExhaustAlign
+  long long m_prescreenRejects;  /// Number of candidates rejected on the banded alignment cover
+  long long m_edgeMaps;        /// Number of long lookups mapped by their edges
+  long long m_edgeFallbacks;   /// Number of long lookups whose edges disagreed
+  svec< std::shared_ptr<MapperContext> > m_workers;  /// Contexts of the helper threads scoring candidates
+  std::shared_ptr<HelperPool> m_helpers;  /// Helper threads, started on the first lookup split over threads
+  const std::atomic<int> * m_dominant;  /// Index of the first dominant candidate of the current lookup
+  int m_candidate;             /// Index of the candidate the context is working on
 };
 
 
@@ -147,9 +364,9 @@ class Kraken
 friend class RouteFinder;
 public:
   //Default ctor
-  Kraken():m_seq(), m_maps(), m_xc(), m_router(), m_params() {}
+  Kraken():m_seq(), m_maps(), m_ctx(), m_router(), m_routesBuilt(), m_params() {}
   //Ctor to set custom params
-  Kraken(const KrakenParams& params):m_seq(), m_maps(), m_xc(), m_router(), m_params(params) {}
+  Kraken(const KrakenParams& params):m_seq(), m_maps(), m_ctx(), m_router(), m_routesBuilt(), m_params(params) {}
 
   void    setLocalAlignAdjust(bool laa)    { m_params.setLocalAlignAdjust(laa);   }
   void    setOverflowAdjust(bool ofa)      { m_params.setOverflowAdjust(ofa);     } 
@@ -158,46 +375,168 @@ public:
   void    setPValThresh(double pvt)        { m_params.setPValThresh(pvt);         }
   void    setMinIdent(double mi)           { m_params.setMinIdent(mi);            }
   void    setMinAlignCover( double mac)    { m_params.setMinAlignCover(mac);      } 
-
-  void Allocate(const string & source, const string & target, double distance = 0.5);
+  void    setSearchIndex(bool si)          { m_params.setSearchIndex(si);         }
+  void    setCandidateThreads(int ct)      { m_params.setCandidateThreads(ct);    }
+  void    setDominantRatio(double dr)      { m_params.setDominantRatio(dr);       }
+  void    setBeamWidth(int bw)             { m_params.setBeamWidth(bw);           }
+  void    setAdaptiveWindow(bool aw)       { m_params.setAdaptiveWindow(aw);      }
+  void    setEdgeThreshold(int et)         { m_params.setEdgeThreshold(et);       }
+  void    setEdgeLength(int el)            { m_params.setEdgeLength(el);          }
+
+  void Allocate(const string & source, const string & target, double distance = 0.5, bool preferred = false);
   void DoneAlloc();
 
   void ReadMap(const string & fileName, const string & source, const string & target, double distance = 0.5);
   void ReadGenome(const string & fileName, const string & name);
+  /** Same as ReadMap but the map is only read when a lookup first needs it */
+  void RegisterMap(const string & fileName, const string & source, const string & target, double distance = 0.5);
+  /** Same as ReadGenome but the genome is only read when a lookup first needs it */
+  void RegisterGenome(const string & fileName, const string & name);
+  /** Reads the given genome and the maps from/to it if they have not been read yet */
+  void Preload(const string & name);
 
   int GenomeCount() const                   {return m_seq.isize();  }
   const string & GenomeName(int i) const    {return m_seq[i].Name();}
+  /** Handle of the named genome for the overloads below taking genome ids, -1 if unknown */
+  int GenomeId(const string & name) const   {return Genome(name);   }
   const svec<GenomeSeq>& GetGenomes() const {return m_seq;          }
   const GenomeWideMap & GetMap(const string & source) const;
   
+  /** Uses the object's own context, hence not to be called from multiple threads */
+  bool Find(const Coordinate & lookup, 
+	    const string & source, 
+	    const string & target,
+            Coordinate& result) {
+    return Find(lookup, source, target, result, m_ctx);
+  }
+
+  /** Same as above but uses the given context, safe to call concurrently with one context per thread */
   bool Find(const Coordinate & lookup, 
 	    const string & source, 
 	    const string & target,
-            Coordinate& result);
+            Coordinate& result,
+            MapperContext& ctx) const {
+    return Find(lookup, GenomeId(source), GenomeId(target), result, ctx);
+  }
+
+  /** Same as above with the genomes given by GenomeId, no names are looked up */
+  bool Find(const Coordinate & lookup, 
+	    int source, 
+	    int target,
+            Coordinate& result,
+            MapperContext& ctx) const;
+
+  /**
+   * Maps all lookups through the route from source to target, one batch per hop (see 
+   * GenomeWideMap::MapBatch). candidates[i] receives the rough regions for lookups[i], 
+   * to be passed on to Refine. Returns false if none of the lookups could be mapped.
+   */
+  bool MapBatch(const svec<Coordinate> & lookups, int source, int target,
+                svec< svec<Coordinate> > & candidates) const;
+  bool MapBatch(const svec<Coordinate> & lookups, const string & source, const string & target,
+                svec< svec<Coordinate> > & candidates) const {
+    return MapBatch(lookups, GenomeId(source), GenomeId(target), candidates);
+  }
+
+  /**
+   * Second half of Find: aligns lookup against its rough candidate regions and sets result 
+   * to the best one. Safe to call concurrently with one context per thread.
+   */
+  bool Refine(const Coordinate & lookup, int source, int target,
+              const svec<Coordinate> & candidates, Coordinate & result, MapperContext & ctx) const;
+  bool Refine(const Coordinate & lookup, const string & source, const string & target,
+              const svec<Coordinate> & candidates, Coordinate & result, MapperContext & ctx) const {
+    return Refine(lookup, GenomeId(source), GenomeId(target), candidates, result, ctx);
+  }
 
+  /** Uses the object's own context, hence not to be called from multiple threads */
   bool FindWithEdges(const Coordinate& lookup, const string & source,
                      const string & target,
-                     int edgeLength, Coordinate& result);
+                     int edgeLength, Coordinate& result) {
+    return FindWithEdges(lookup, source, target, edgeLength, result, m_ctx);
+  }
+
+  bool FindWithEdges(const Coordinate& lookup, const string & source,
+                     const string & target,
+                     int edgeLength, Coordinate& result,
+                     MapperContext& ctx) const {
+    return FindWithEdges(lookup, GenomeId(source), GenomeId(target), edgeLength, result, ctx);
+  }
+
+  bool FindWithEdges(const Coordinate& lookup, int source, int target,
+                     int edgeLength, Coordinate& result,
+                     MapperContext& ctx) const;
+
+  /** Whether RefineItem tries to map lookup by its edges before aligning it in full */
+  bool MapsByEdges(const Coordinate & lookup) const;
+  /** 
+   * Same as MapBatch, but the lookups mapped by their edges get no candidates, as RefineItem 
+   * only needs them if the edges disagree and then finds them itself.
+   */
+  bool MapItemBatch(const svec<Coordinate> & lookups, int source, int target,
+                    svec< svec<Coordinate> > & candidates) const;
+
+  /**
+   * Refine with the edge policy: a lookup longer than the edge threshold is mapped by its 
+   * edges alone, unless they disagree or land too far apart, in which case it is aligned in 
+   * full as by Find. Lookups up to the threshold are refined as usual. The candidates of 
+   * lookups mapped by their edges are not used (see MapItemBatch).
+   */
+  bool RefineItem(const Coordinate & lookup, int source, int target,
+                  const svec<Coordinate> & candidates, Coordinate & result, MapperContext & ctx) const;
 
 private:
-  bool RoughMap(const Coordinate& lookup, const string& source, const string& target,
-                DNAVector& sourceSeq, DNAVector& targetSeq, int& maxPos,
-                float& maxVal, int& len, Coordinate& result); 
-  bool SetSequence(const vecDNAVector& genome, Coordinate& coords, DNAVector& resultSeq);
-  bool RoughAlign(DNAVector& target, DNAVector& source, int& maxPos, float& maxVal, int& len, Coordinate& result); 
-  void Ccorrelate(const DNAVector& q, const DNAVector& t, double size, float& maxValOut, int& maxPosOut); 
-  bool ExhaustAlign(DNAVector& trueDestination, DNAVector& source, int slack, Coordinate& result);
-  int  Index(const string & source, const string & target);
-  int  Genome(const string & name);
+  bool RoughMap(const Coordinate& lookup, int source, int target,
+                DNAVector& sourceSeq, std::shared_ptr<TargetWindow>& window, int& maxPos,
+                float& maxVal, int& len, Coordinate& result, MapperContext& ctx) const; 
+  /** Bases added on each side of a rough candidate region before cross-correlating it */
+  int  WindowPadding(const Coordinate& lookup, const Coordinate& candidate) const;
+  /** 
+   * Length and overlap of the destination window blocks cross-correlated against a source of the 
+   * given length, the blocks always advancing by a positive stride (blockLen - overlap)
+   */
+  void BlockLayout(int sourceLen, MultiSizeXCorr& xc, int& blockLen, int& blockOverlap) const;
+  /** Forward strand sequence of coords clamped to the chromosome, whatever the strand of coords */
+  bool SetSequence(const GenomeSeq& genome, Coordinate& coords, DNAVector& resultSeq) const;
+  bool ClampToChromosome(const GenomeSeq& genome, Coordinate& coords) const;
+  bool RoughAlign(const DNAView& target, const DNAVector& source, int& maxPos, float& maxVal, int& len, 
+                  Coordinate& result, MapperContext& ctx) const; 
+  void Ccorrelate(const DNAView& q, const DNAVector& t, double size, float& maxValOut, 
+                  int& maxPosOut, MapperContext& ctx) const; 
+  bool ExhaustAlign(const DNAView& trueDestination, const DNAVector& source, int slack, Coordinate& result, 
+                    MapperContext& ctx) const;
+  int  Index(const string & source, const string & target) const;
+  int  Genome(const string & name) const;
+  /** Route table, built on first use after the genomes or maps changed */
+  const RouteFinder & Router() const;
   
-  bool MapThroughRoute(const Route & route, svec<Coordinate>& results, const Coordinate & lookup);
+  bool MapThroughRoute(const Route & route, svec<Coordinate>& results, const Coordinate & lookup) const;
+  bool MapThroughRoute(const Route & route, svec< svec<Coordinate> >& results, const svec<Coordinate> & lookups) const;
+  /**
+   * Same as FindWithEdges but fails unless both edges map to the same chromosome and strand 
+   * in the order of the lookup, the region between them being the result.
+   */
+  bool FindWithAgreeingEdges(const Coordinate& lookup, int source, int target, int edgeLength,
+                             Coordinate& result, MapperContext& ctx) const;
+
+  /** Outcome of the rough alignment of one candidate region in Refine */
+  struct CandidateScore {
+    CandidateScore(): ok(false), maxPos(-1), maxVal(0), len(-1), ctx(NULL), window() {}
+    bool ok;
+    int maxPos;
+    float maxVal;
+    int len;
+    MapperContext * ctx;  /// Context the candidate was scored with
+    std::shared_ptr<TargetWindow> window;  /// Destination window of the candidate
+  };
 
 
   svec<GenomeSeq> m_seq;
   svec<GenomeWideMap> m_maps;
 
-  MultiSizeXCorr m_xc;
-  RouteFinder m_router;
+  MapperContext m_ctx;    /// Context used by the lookups that do not provide their own
+  mutable RouteFinder m_router;
+  LazyLoad m_routesBuilt; /// Guards building m_router, reset whenever genomes or maps are added
 
   KrakenParams m_params;  /// Set of parameters containing, Threshold of pValue, min ident value and trans limit size among other items
 };
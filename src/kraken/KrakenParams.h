@@ -5,10 +5,18 @@ class KrakenParams
 {
 public:
   KrakenParams(bool laAdjust=false, bool ofAdjust=true, int transSizeLimit=200000, int mapSizeLimit=300000,
-               double pValThreshold=0.001, double minIdent=0.2, double minAlignCover=0.3
+               double pValThreshold=0.001, double minIdent=0.2, double minAlignCover=0.3,
+               bool searchIndex=true,
+               int candidateThreads=1, double dominantRatio=0.0, int beamWidth=1,
+               bool adaptiveWindow=false, int edgeThreshold=0, int edgeLength=200
               )
               :m_laAdjust(laAdjust), m_ofAdjust(ofAdjust), m_transSizeLimit(transSizeLimit), m_mapSizeLimit(mapSizeLimit),
-               m_pValThreshold(pValThreshold), m_minIdent(minIdent), m_minAlignCover(minAlignCover) {}
+               m_pValThreshold(pValThreshold), m_minIdent(minIdent), m_minAlignCover(minAlignCover),
+               m_searchIndex(searchIndex),
+               m_candidateThreads(candidateThreads),
+               m_dominantRatio(dominantRatio), m_beamWidth(beamWidth),
+               m_adaptiveWindow(adaptiveWindow), m_edgeThreshold(edgeThreshold),
+               m_edgeLength(edgeLength) {}
  
     bool    isLocalAlignAdjust() const  { return m_laAdjust;       }
     bool    isOverflowAdjust() const    { return m_ofAdjust;       } 
@@ -17,6 +25,13 @@ public:
     double  getPValThresh() const       { return m_pValThreshold;  }
     double  getMinIdent() const         { return m_minIdent;       }
     double  getMinAlignCover() const    { return m_minAlignCover;  }
+    bool    isSearchIndex() const       { return m_searchIndex;    }
+    int     getCandidateThreads() const { return m_candidateThreads; }
+    double  getDominantRatio() const    { return m_dominantRatio;  }
+    int     getBeamWidth() const        { return m_beamWidth;      }
+    bool    isAdaptiveWindow() const    { return m_adaptiveWindow; }
+    int     getEdgeThreshold() const    { return m_edgeThreshold;  }
+    int     getEdgeLength() const       { return m_edgeLength;     }
 
     void    setLocalAlignAdjust(bool laa)    { m_laAdjust = laa;       }
     void    setOverflowAdjust(bool ofa)      { m_ofAdjust = ofa;       } 
@@ -25,6 +40,13 @@ public:
     void    setPValThresh(double pvt)        { m_pValThreshold = pvt;  }
     void    setMinIdent(double mi)           { m_minIdent =  mi;       }
     void    setMinAlignCover( double mac)    { m_minAlignCover = mac;  }
+    void    setSearchIndex(bool si)          { m_searchIndex = si;     }
+    void    setCandidateThreads(int ct)      { m_candidateThreads = ct; }
+    void    setDominantRatio(double dr)      { m_dominantRatio = dr;   }
+    void    setBeamWidth(int bw)             { m_beamWidth = bw;       }
+    void    setAdaptiveWindow(bool aw)       { m_adaptiveWindow = aw;  }
+    void    setEdgeThreshold(int et)         { m_edgeThreshold = et;   }
+    void    setEdgeLength(int el)            { m_edgeLength = el;      }
 
 private: 
   bool   m_laAdjust;          /// Choose if mapped region boundaries should be adjusted/limited with local alignment values
@@ -34,6 +56,13 @@ private:
   double m_pValThreshold;     /// P-value threshold for acceptable alignment of translated region
   double m_minIdent;          /// Minimum alignment sequence identity acceptable for a translated region
   double m_minAlignCover;     /// Minimum acceptable portion of sequence covered by exhasustive alignment
+  bool   m_searchIndex;       /// Search synteny blocks through their Eytzinger index rather than by plain binary search
+  int    m_candidateThreads;  /// Number of threads scoring the candidate regions of one lookup concurrently
+  double m_dominantRatio;     /// Cross-correlation maximum per base at which a candidate dominates the ones after it (0: never)
+  int    m_beamWidth;         /// Number of non-overlapping candidate regions carried from one route hop to the next
+  bool   m_adaptiveWindow;    /// Size the window padding and cross-correlation blocks from the lookup instead of the fixed defaults
+  int    m_edgeThreshold;     /// Items longer than this are mapped by their edges when these agree (0: never)
+  int    m_edgeLength;        /// Length of the edges mapped for long items
  
 };
 //======================================================
@@ -0,0 +1,46 @@
+#ifndef _LAZYLOAD_H_
+#define _LAZYLOAD_H_
+
+#include <atomic>
+#include <mutex>
+
+//======================================================
+/**
+ * Thread-safe guard for loading data on first use.
+ * Unlike std::once_flag it can be copied along with the data it guards,
+ * the copy keeps track of whether its own data has been loaded.
+ */
+class LazyLoad
+{
+public:
+  LazyLoad(): m_done(false), m_mutex() {}
+  LazyLoad(const LazyLoad & other): m_done(other.IsDone()), m_mutex() {}
+
+  LazyLoad & operator = (const LazyLoad & other) {
+    m_done.store(other.IsDone());
+    return *this;
+  }
+
+  bool IsDone() const { return m_done.load(std::memory_order_acquire); }
+
+  /** Marks the data as stale so that the next Run loads it again, not to be called concurrently with Run */
+  void Reset() { m_done.store(false, std::memory_order_release); }
+
+  /** Runs load unless it has already been run, concurrent callers wait for the first one to finish */
+  template<class Func>
+  void Run(Func load) const {
+    if (IsDone())
+      return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_done.load(std::memory_order_relaxed))
+      return;
+    load();
+    m_done.store(true, std::memory_order_release);
+  }
+
+private:
+  mutable std::atomic<bool> m_done;  /// Set once the data has been loaded
+  mutable std::mutex m_mutex;        /// Serialises the loading
+};
+
+#endif //_LAZYLOAD_H_
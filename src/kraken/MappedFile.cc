@@ -0,0 +1,44 @@
+#ifndef FORCE_DEBUG
+#define NDEBUG
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ryggrad/src/base/Logger.h"
+#include "MappedFile.h"
+
+//======================================================
+bool MappedFile::Open(const string & fileName)
+{
+  Close();
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    FILE_LOG(logERROR) << "Could not open file: " << fileName;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    FILE_LOG(logERROR) << "Could not read size of file: " << fileName;
+    close(fd);
+    return false;
+  }
+  void * p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    FILE_LOG(logERROR) << "Could not map file: " << fileName;
+    return false;
+  }
+  m_data = static_cast<const char*>(p);
+  m_size = st.st_size;
+  return true;
+}
+
+void MappedFile::Close()
+{
+  if (m_data != NULL)
+    munmap(const_cast<char*>(m_data), m_size);
+  m_data = NULL;
+  m_size = 0;
+}
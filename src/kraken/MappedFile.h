@@ -0,0 +1,30 @@
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+#include "ryggrad/src/base/SVector.h"
+
+//======================================================
+/**
+ * Read-only memory mapping of a file, unmapped when the last owner goes away
+ */
+class MappedFile
+{
+public:
+  MappedFile(): m_data(NULL), m_size(0) {}
+  ~MappedFile() { Close(); }
+
+  bool Open(const string & fileName);
+  void Close();
+
+  const char * Data() const { return m_data; }
+  size_t Size() const       { return m_size; }
+
+private:
+  MappedFile(const MappedFile &);        // Not copyable, share through a pointer instead
+  void operator=(const MappedFile &);
+
+  const char * m_data;  /// Start of the mapped region
+  size_t m_size;        /// Size of the mapped region in bytes
+};
+
+#endif //_MAPPEDFILE_H_
@@ -0,0 +1,29 @@
+#include <string>
+#include "ryggrad/src/base/CommandLineParser.h"
+#include "ryggrad/src/base/Logger.h"
+#include "ryggrad/src/general/DNAVector.h"
+#include "PackedGenome.h"
+
+int main(int argc,char** argv)
+{
+  commandArg<string> aStringCmmd("-i", "Input genome FASTA file");
+  commandArg<string> bStringCmmd("-o", "Output packed genome file");
+  commandLineParser P(argc,argv);
+  P.SetDescription("Converts a FASTA genome into the packed format (2 bits per base) that can be memory mapped by Kraken.\
+                    The packed file can be used in place of the FASTA file in the [genomes] section of the config.\
+                    Bases other than ACGT become N and lowercase (soft-masked) bases are stored in upper case.");
+  P.registerArg(aStringCmmd);
+  P.registerArg(bStringCmmd);
+  P.parse();
+  string inFile  = P.GetStringValueFor(aStringCmmd);
+  string outFile = P.GetStringValueFor(bStringCmmd);
+
+  vecDNAVector dna;
+  dna.Read(inFile);
+  if (!PackedGenome::Write(outFile, dna)) {
+    cout << "Failed to write packed genome: " << outFile << endl;
+    return 1;
+  }
+  cout << "Packed " << dna.isize() << " sequences into " << outFile << endl;
+  return 0;
+}
@@ -0,0 +1,257 @@
+#ifndef FORCE_DEBUG
+#define NDEBUG
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include "ryggrad/src/base/Logger.h"
+#include "PackedGenome.h"
+
+static const char     PACKED_MAGIC[8] = {'K', 'R', 'K', 'N', 'P', 'G', 0, 0};
+static const uint32_t PACKED_VERSION  = 1;
+
+//======================================================
+static uint8_t BaseCode(char c)
+{
+  switch (c) {
+  case 'A': case 'a': return 0;
+  case 'C': case 'c': return 1;
+  case 'G': case 'g': return 2;
+  case 'T': case 't': return 3;
+  default: return 4;
+  }
+}
+
+string PackedGenome::CoordName(const string & fastaName)
+{
+  string name = fastaName;
+  name.erase(std::remove(name.begin(), name.end(), '>'), name.end());
+  return name;
+}
+
+bool PackedGenome::IsPacked(const string & fileName)
+{
+  FILE * pFile = fopen(fileName.c_str(), "rb");
+  if (pFile == NULL)
+    return false;
+  char magic[8];
+  bool packed = (fread(magic, 1, 8, pFile) == 8 && memcmp(magic, PACKED_MAGIC, 8) == 0);
+  fclose(pFile);
+  return packed;
+}
+
+bool PackedGenome::Write(const string & fileName, const vecDNAVector & dna)
+{
+  FILE * pFile = fopen(fileName.c_str(), "wb");
+  if (pFile == NULL) {
+    FILE_LOG(logERROR) << "Could not open file for writing: " << fileName;
+    return false;
+  }
+  int i, j;
+  PackedGenomeHeader header;
+  memcpy(header.magic, PACKED_MAGIC, 8);
+  header.version    = PACKED_VERSION;
+  header.chromCount = dna.isize();
+
+  // Names go right after the index, the sequence data after the names
+  svec<PackedChromIndex> index;
+  index.resize(dna.isize());
+  string names;
+  for (i=0; i<dna.isize(); i++) {
+    index[i].nameOffset = names.size();
+    names += CoordName(dna[i].getName());
+    names += '\0';
+  }
+  header.namesOffset = sizeof(PackedGenomeHeader) + index.size() * sizeof(PackedChromIndex);
+  uint64_t offset = header.namesOffset + names.size();
+  offset = (offset + 7) & ~((uint64_t)7);
+
+  svec< svec<uint32_t> > nRuns;
+  nRuns.resize(dna.isize());
+  long long softMasked = 0;
+  for (i=0; i<dna.isize(); i++) {
+    const DNAVector & d = dna[i];
+    for (j=0; j<d.isize(); j++) {
+      if (d[j] >= 'a' && d[j] <= 'z')
+        softMasked++;
+      if (BaseCode(d[j]) != 4)
+        continue;
+      svec<uint32_t> & runs = nRuns[i];
+      if (runs.isize() > 0 && runs[runs.isize()-2] + runs[runs.isize()-1] == (uint32_t)j) {
+        runs[runs.isize()-1]++;
+      } else {
+        runs.push_back(j);
+        runs.push_back(1);
+      }
+    }
+    index[i].length     = d.isize();
+    index[i].nRunCount  = nRuns[i].isize()/2;
+    index[i].reserved   = 0;
+    index[i].seqOffset  = offset;
+    offset += (d.isize() + 3)/4;
+    offset = (offset + 7) & ~((uint64_t)7);
+    index[i].nRunOffset = offset;
+    offset += nRuns[i].size() * sizeof(uint32_t);
+  }
+  if (softMasked > 0)
+    FILE_LOG(logWARNING) << "Soft-masking is not kept in packed genomes, " << softMasked 
+                         << " lowercase bases will read as upper case: " << fileName;
+
+  fwrite(&header, sizeof(header), 1, pFile);
+  if (index.size() > 0)
+    fwrite(&index[0], sizeof(PackedChromIndex), index.size(), pFile);
+  fwrite(names.c_str(), 1, names.size(), pFile);
+  svec<uint8_t> packed;
+  for (i=0; i<dna.isize(); i++) {
+    const DNAVector & d = dna[i];
+    fseek(pFile, index[i].seqOffset, SEEK_SET);
+    packed.clear();
+    packed.resize((d.isize() + 3)/4);
+    for (j=0; j<d.isize(); j++) {
+      uint8_t code = BaseCode(d[j]);
+      if (code == 4)
+        code = 0;  // Masked by the N-runs
+      packed[j/4] |= code << (2*(j%4));
+    }
+    if (packed.size() > 0)
+      fwrite(&packed[0], 1, packed.size(), pFile);
+    fseek(pFile, index[i].nRunOffset, SEEK_SET);
+    if (nRuns[i].size() > 0)
+      fwrite(&nRuns[i][0], sizeof(uint32_t), nRuns[i].size(), pFile);
+  }
+  bool ok = (ferror(pFile) == 0);
+  fclose(pFile);
+  if (!ok)
+    FILE_LOG(logERROR) << "Failed writing packed genome: " << fileName;
+  return ok;
+}
+
+//======================================================
+class CompareChromName
+{
+public:
+  CompareChromName(const svec<string> & names): m_names(names) {}
+  bool operator() (int a, int b) const { return m_names[a] < m_names[b]; }
+private:
+  const svec<string> & m_names;
+};
+
+bool PackedGenome::Open(const string & fileName)
+{
+  std::shared_ptr<MappedFile> file(new MappedFile);
+  if (!file->Open(fileName))
+    return false;
+  const PackedGenomeHeader * header = reinterpret_cast<const PackedGenomeHeader*>(file->Data());
+  if (file->Size() < sizeof(PackedGenomeHeader) || memcmp(header->magic, PACKED_MAGIC, 8) != 0
+      || header->version != PACKED_VERSION) {
+    FILE_LOG(logERROR) << "Not a packed genome file (or wrong version): " << fileName;
+    return false;
+  }
+  if (!Validate(*file)) {
+    FILE_LOG(logERROR) << "Packed genome file is truncated or corrupt: " << fileName;
+    return false;
+  }
+  m_file = file;
+  m_names.resize(header->chromCount);
+  m_sorted.resize(header->chromCount);
+  for (int i=0; i<m_names.isize(); i++) {
+    m_names[i]  = m_file->Data() + header->namesOffset + Index(i).nameOffset;
+    m_sorted[i] = i;
+  }
+  sort(m_sorted.begin(), m_sorted.end(), CompareChromName(m_names));
+  FILE_LOG(logDEBUG) << "Mapped packed genome with " << m_names.isize() << " chromosomes: " << fileName;
+  return true;
+}
+
+bool PackedGenome::Validate(const MappedFile & file)
+{
+  // All offsets are checked as 64 bit values so that corrupt ones cannot wrap around
+  const uint64_t size = file.Size();
+  const PackedGenomeHeader * header = reinterpret_cast<const PackedGenomeHeader*>(file.Data());
+  uint64_t indexEnd = sizeof(PackedGenomeHeader) + (uint64_t)header->chromCount * sizeof(PackedChromIndex);
+  if (indexEnd > size || header->namesOffset < indexEnd || header->namesOffset > size)
+    return false;
+  const PackedChromIndex * index = reinterpret_cast<const PackedChromIndex*>(file.Data() + sizeof(PackedGenomeHeader));
+  for (uint32_t i=0; i<header->chromCount; i++) {
+    const PackedChromIndex & c = index[i];
+    uint64_t name = header->namesOffset + c.nameOffset;
+    if (name >= size || memchr(file.Data() + name, 0, size - name) == NULL)
+      return false;
+    if (c.length > (uint32_t)std::numeric_limits<int>::max() 
+        || c.seqOffset > size || (c.length + 3ULL)/4 > size - c.seqOffset)
+      return false;
+    if (c.nRunOffset % sizeof(uint32_t) != 0 || c.nRunOffset > size 
+        || 2ULL * sizeof(uint32_t) * c.nRunCount > size - c.nRunOffset)
+      return false;
+    const uint32_t * runs = reinterpret_cast<const uint32_t*>(file.Data() + c.nRunOffset);
+    for (uint32_t r=0; r<c.nRunCount; r++) {
+      if ((uint64_t)runs[2*r] + runs[2*r+1] > c.length)
+        return false;
+    }
+  }
+  return true;
+}
+
+int PackedGenome::ChromIndex(const string & name) const
+{
+  int lo = 0;
+  int hi = m_sorted.isize();
+  while (lo < hi) {
+    int mid = (lo + hi)/2;
+    if (m_names[m_sorted[mid]] < name)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo < m_sorted.isize() && m_names[m_sorted[lo]] == name)
+    return m_sorted[lo];
+  return -1;
+}
+
+char PackedGenome::Base(int chrom, int pos) const
+{
+  static const char bases[4] = {'A', 'C', 'G', 'T'};
+  const PackedChromIndex & index = Index(chrom);
+  const uint32_t * runs = reinterpret_cast<const uint32_t*>(m_file->Data() + index.nRunOffset);
+  // Last run starting at or before pos
+  int lo = 0;
+  int hi = index.nRunCount;
+  while (lo < hi) {
+    int mid = (lo + hi)/2;
+    if (runs[2*mid] <= (uint32_t)pos)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo > 0 && runs[2*(lo-1)] + runs[2*(lo-1)+1] > (uint32_t)pos)
+    return 'N';
+  const uint8_t * seq = reinterpret_cast<const uint8_t*>(m_file->Data() + index.seqOffset);
+  return bases[(seq[pos/4] >> (2*(pos%4))) & 3];
+}
+
+void PackedGenome::Extract(int chrom, int start, int len, DNAVector & out) const
+{
+  static const char bases[4] = {'A', 'C', 'G', 'T'};
+  const PackedChromIndex & index = Index(chrom);
+  const uint8_t * seq = reinterpret_cast<const uint8_t*>(m_file->Data() + index.seqOffset);
+  int i;
+  out.resize(len);
+  for (i=0; i<len; i++) {
+    int pos = start + i;
+    out[i] = bases[(seq[pos/4] >> (2*(pos%4))) & 3];
+  }
+
+  // Mask the N-runs overlapping the extracted region
+  const uint32_t * runs = reinterpret_cast<const uint32_t*>(m_file->Data() + index.nRunOffset);
+  for (uint32_t r=0; r<index.nRunCount; r++) {
+    int runStart = runs[2*r];
+    int runStop  = runStart + runs[2*r+1];
+    if (runStart >= start + len)
+      break;
+    if (runStop <= start)
+      continue;
+    for (i=max(runStart, start); i<min(runStop, start + len); i++)
+      out[i - start] = 'N';
+  }
+}
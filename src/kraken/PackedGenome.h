@@ -0,0 +1,85 @@
+#ifndef _PACKEDGENOME_H_
+#define _PACKEDGENOME_H_
+
+#include <memory>
+#include <stdint.h>
+#include "ryggrad/src/base/SVector.h"
+#include "ryggrad/src/general/DNAVector.h"
+#include "MappedFile.h"
+
+//======================================================
+/** Header at the start of a packed genome file */
+struct PackedGenomeHeader
+{
+  char     magic[8];      /// "KRKNPG" followed by two zero bytes
+  uint32_t version;       /// Format version
+  uint32_t chromCount;    /// Number of chromosomes in the index
+  uint64_t namesOffset;   /// File offset of the chromosome names (each zero terminated)
+};
+
+/** Index entry for one chromosome of a packed genome file, entries follow the header */
+struct PackedChromIndex
+{
+  uint64_t seqOffset;     /// File offset of the 2-bit packed bases (4 bases per byte, first base in the low bits)
+  uint64_t nRunOffset;    /// File offset of the N-runs (pairs of uint32 start/length)
+  uint32_t length;        /// Number of bases
+  uint32_t nRunCount;     /// Number of N-runs
+  uint32_t nameOffset;    /// Offset of the name relative to namesOffset
+  uint32_t reserved;
+};
+
+//======================================================
+/**
+ * Genome stored with 2 bits per base, a mask of N-runs, and a chromosome index.
+ * The file is built once from a FASTA file (see PackGenome) and memory mapped
+ * when loaded, so that loading is near instant and the pages are shared among
+ * processes using the same genome. Bases other than ACGT are stored as N, and
+ * soft-masking is not kept: lowercase bases are read back in upper case.
+ */
+class PackedGenome
+{
+public:
+  PackedGenome(): m_file(), m_names(), m_sorted() {}
+
+  /** 
+   * Chromosome name used in coordinates for the given FASTA name, the same one whether the
+   * genome is read packed or from FASTA: the name with the '>' removed, description included
+   */
+  static string CoordName(const string & fastaName);
+
+  /** Checks whether the given file is a packed genome (as opposed to FASTA) */
+  static bool IsPacked(const string & fileName);
+
+  /** Writes the given sequences into a packed genome file */
+  static bool Write(const string & fileName, const vecDNAVector & dna);
+
+  /** Maps the given packed genome file, fails if it is truncated or its index points outside of it */
+  bool Open(const string & fileName);
+
+  bool IsOpen() const                        { return m_file.get() != NULL;      }
+  int  ChromCount() const                    { return m_names.isize();           }
+  const string & ChromName(int i) const      { return m_names[i];                }
+  int  ChromSize(int i) const                { return Index(i).length;           }
+  /** Index of the chromosome with the given name, -1 if it does not exist */
+  int  ChromIndex(const string & name) const;
+
+  /** Decodes len bases of chromosome chrom starting at start into out */
+  void Extract(int chrom, int start, int len, DNAVector & out) const;
+
+  /** Decodes the single base at the given position */
+  char Base(int chrom, int pos) const;
+
+private:
+  /** Checks that the names, bases and N-runs of all chromosomes lie within the file */
+  static bool Validate(const MappedFile & file);
+
+  const PackedChromIndex & Index(int i) const {
+    return reinterpret_cast<const PackedChromIndex*>(m_file->Data() + sizeof(PackedGenomeHeader))[i];
+  }
+
+  std::shared_ptr<MappedFile> m_file;  /// Mapping of the packed file shared among copies
+  svec<string> m_names;                /// Chromosome names in file order
+  svec<int> m_sorted;                  /// Chromosome indexes sorted by name for lookups
+};
+
+#endif //_PACKEDGENOME_H_
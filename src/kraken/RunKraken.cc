@@ -25,6 +25,13 @@ int main(int argc,char** argv)
   commandArg<double> lStringCmmd("-i", "Minimum sequence identity acceptable for a translated region", 0.0);
   commandArg<double> mStringCmmd("-C", "Minimum alignment coverage of mapped region for accepting tanslation ", 0.3);
   commandArg<bool>   outputAllCmmd("-a", "Output GTF input items even if they have not been mapped (0: false, 1: true)", false);
+  commandArg<int>    threadsCmmd("-j", "Number of threads used for translating the annotation items", 1);
+  commandArg<int>    candThreadsCmmd("-J", "Number of threads scoring the candidate regions of a split item", 1);
+  commandArg<double> dominantCmmd("-D", "Cross-correlation maximum per base at which a candidate region makes the later ones unnecessary (0: off)", 0.0);
+  commandArg<int>    beamCmmd("-b", "Number of candidate regions followed through each hop of a multi-hop route", 1);
+  commandArg<bool>   adaptiveCmmd("-A", "Size destination windows and cross-correlation blocks from the item length instead of fixed sizes", false);
+  commandArg<int>    edgeThreshCmmd("-E", "Items longer than this are mapped by their edges, in full only if the edges disagree or land too far apart (0: off)", 10000);
+  commandArg<int>    edgeLenCmmd("-e", "Length of the edges mapped for long items", 200);
   commandLineParser P(argc,argv);
   P.SetDescription("Batch mode GTF transfer/comparison from an source to target genome.");
   P.registerArg(aStringCmmd);
@@ -43,6 +50,13 @@ int main(int argc,char** argv)
   P.registerArg(lStringCmmd);
   P.registerArg(mStringCmmd);
   P.registerArg(outputAllCmmd);
+  P.registerArg(threadsCmmd);
+  P.registerArg(candThreadsCmmd);
+  P.registerArg(dominantCmmd);
+  P.registerArg(beamCmmd);
+  P.registerArg(adaptiveCmmd);
+  P.registerArg(edgeThreshCmmd);
+  P.registerArg(edgeLenCmmd);
   P.parse();
   string rumConfigFile    = P.GetStringValueFor(aStringCmmd);
   string sourceAnnotFile  = P.GetStringValueFor(bStringCmmd);
@@ -60,6 +74,13 @@ int main(int argc,char** argv)
   double minIdent         = P.GetDoubleValueFor(lStringCmmd);
   double minCover         = P.GetDoubleValueFor(mStringCmmd);
   bool   outputAll        = P.GetBoolValueFor(outputAllCmmd);
+  int    numThreads       = P.GetIntValueFor(threadsCmmd);
+  int    candThreads      = P.GetIntValueFor(candThreadsCmmd);
+  double dominantRatio    = P.GetDoubleValueFor(dominantCmmd);
+  int    beamWidth        = P.GetIntValueFor(beamCmmd);
+  bool   adaptiveWindow   = P.GetBoolValueFor(adaptiveCmmd);
+  int    edgeThreshold    = P.GetIntValueFor(edgeThreshCmmd);
+  int    edgeLength       = P.GetIntValueFor(edgeLenCmmd);
  
   FILE* pFile = fopen(applicationFile.c_str(), "w");
   Output2FILE::Stream()     = pFile;
@@ -74,6 +95,13 @@ int main(int argc,char** argv)
   transer.setPValThresh(pValThreshold);
   transer.setLocalAlignAdjust(laAdjust);
   transer.setOverflowAdjust(ofAdjust);
+  transer.setNumThreads(numThreads);
+  transer.setCandidateThreads(candThreads);
+  transer.setDominantRatio(dominantRatio);
+  transer.setBeamWidth(beamWidth);
+  transer.setAdaptiveWindow(adaptiveWindow);
+  transer.setEdgeThreshold(edgeThreshold);
+  transer.setEdgeLength(edgeLength);
   TransAnnotation sourceAnnot = TransAnnotation(sourceAnnotFile, sourceGenomeId);
   
   // Map Transcripts onto corresponding exons and infer corresponding 
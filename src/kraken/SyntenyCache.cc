@@ -0,0 +1,431 @@
+#ifndef FORCE_DEBUG
+#define NDEBUG
+#endif
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string.h>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ryggrad/src/base/Logger.h"
+#include "ryggrad/src/base/FileParser.h"
+#include "ryggrad/src/general/AlignmentBlock.h"
+#include "MappedFile.h"
+#include "SyntenyCache.h"
+
+static const char     CACHE_MAGIC[8] = {'K', 'R', 'K', 'N', 'S', 'C', 0, 0};
+static const uint32_t CACHE_VERSION  = 2;
+
+/** Header at the start of the sidecar, followed by the two name tables and the arrays of both orientations */
+struct SyntenyCacheHeader
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  int64_t  sourceSize;       /// Size of the synteny file the sidecar was made from
+  int64_t  sourceTime;       /// Modification time of the synteny file the sidecar was made from
+  uint64_t nameCount[2];     /// Number of chromosome names of the first and the second genome
+  uint64_t namesSize;        /// Bytes taken by the names (zero terminated, padded to 8 bytes)
+  uint64_t blockCount;       /// Number of blocks in each orientation
+};
+
+//======================================================
+int SyntenyBlockSet::TargetChromId(const string & chr) const
+{
+  svec<string>::const_iterator it = lower_bound(targetChroms.begin(), targetChroms.end(), chr);
+  if (it == targetChroms.end() || *it != chr)
+    return -1;
+  return (int)(it - targetChroms.begin());
+}
+
+int SyntenyBlockSet::TargetChrom(int i) const
+{
+  return (int)(upper_bound(chromOffset.begin(), chromOffset.end(), i) - chromOffset.begin()) - 1;
+}
+
+SyntenyBlock SyntenyBlockSet::Block(int i) const
+{
+  SyntenyBlock b;
+  b.targetChrom = TargetChrom(i);
+  b.targetStart = targetStart[i];
+  b.targetStop  = targetStop[i];
+  b.queryChrom  = queryChrom[i];
+  b.queryStart  = queryStart[i];
+  b.queryStop   = queryStop[i];
+  b.reversed    = reversed[i];
+  return b;
+}
+
+void SyntenyBlockSet::Assign(svec<SyntenyBlock> & records)
+{
+  sort(records.begin(), records.end());
+  int n = records.isize();
+  chromOffset.resize(targetChroms.isize() + 1);
+  targetStart.resize(n);
+  targetStop.resize(n);
+  queryChrom.resize(n);
+  queryStart.resize(n);
+  queryStop.resize(n);
+  reversed.resize(n);
+  int chr = 0;
+  for (int i=0; i<n; i++) {
+    const SyntenyBlock & b = records[i];
+    while (chr <= b.targetChrom)
+      chromOffset[chr++] = i;
+    targetStart[i] = b.targetStart;
+    targetStop[i]  = b.targetStop;
+    queryChrom[i]  = b.queryChrom;
+    queryStart[i]  = b.queryStart;
+    queryStop[i]   = b.queryStop;
+    reversed[i]    = b.reversed;
+  }
+  while (chr < chromOffset.isize())
+    chromOffset[chr++] = n;
+}
+
+void SyntenyBlockSet::BuildSearchIndex()
+{
+  searchIndex.resize(targetChroms.isize());
+  for (int chr=0; chr<targetChroms.isize(); chr++) {
+    int first = ChromBegin(chr);
+    searchIndex[chr].Build(targetStart.empty() ? NULL : &targetStart[first], ChromEnd(chr) - first);
+  }
+}
+
+int SyntenyBlockSet::LowerBound(int chr, int pos, bool useIndex) const
+{
+  if (useIndex && !searchIndex.empty())
+    return ChromBegin(chr) + searchIndex[chr].LowerBound(pos);
+  const int32_t * starts = targetStart.empty() ? NULL : &targetStart[0];
+  return (int)(lower_bound(starts + ChromBegin(chr), starts + ChromEnd(chr), pos) - starts);
+}
+
+void SyntenyBlockSet::Flip(SyntenyBlockSet & flipped) const
+{
+  flipped.targetChroms = queryChroms;
+  flipped.queryChroms  = targetChroms;
+  svec<SyntenyBlock> records;
+  records.resize(Size());
+  for (int chr=0; chr<targetChroms.isize(); chr++) {
+    for (int i=ChromBegin(chr); i<ChromEnd(chr); i++) {
+      SyntenyBlock & f = records[i];
+      f.targetChrom = queryChrom[i];
+      f.targetStart = queryStart[i];
+      f.targetStop  = queryStop[i];
+      f.queryChrom  = chr;
+      f.queryStart  = targetStart[i];
+      f.queryStop   = targetStop[i];
+      f.reversed    = reversed[i];
+    }
+  }
+  flipped.Assign(records);
+}
+
+void SyntenyBlockSet::clear()
+{
+  targetChroms.clear();
+  queryChroms.clear();
+  chromOffset.clear();
+  targetStart.clear();
+  targetStop.clear();
+  queryChrom.clear();
+  queryStart.clear();
+  queryStop.clear();
+  reversed.clear();
+  searchIndex.clear();
+}
+
+//======================================================
+// Assigns ids to names in sorted order and returns the mapping from the ids handed out while parsing
+static void InternSorted(const map<string, int> & ids, svec<string> & names, svec<int> & remap)
+{
+  names.clear();
+  remap.resize(ids.size());
+  for (map<string, int>::const_iterator it = ids.begin(); it != ids.end(); ++it) {
+    remap[it->second] = names.isize();
+    names.push_back(it->first);
+  }
+}
+
+bool SyntenyCache::Parse(const string & fileName, SyntenyBlockSet & blocks)
+{
+  FlatFileParser parser;
+  if (!parser.Open(fileName))
+    return false;
+
+  map<string, int> targetIds, queryIds;
+  AlignmentBlock block;
+  svec<SyntenyBlock> records;
+  blocks.clear();
+  records.reserve(1000000);
+  while (block.parse(parser, false)) {
+    SyntenyBlock b;
+    map<string, int>::iterator it = targetIds.insert(make_pair(block.getTargetChrom(), (int)targetIds.size())).first;
+    b.targetChrom = it->second;
+    it = queryIds.insert(make_pair(block.getQueryChrom(), (int)queryIds.size())).first;
+    b.queryChrom  = it->second;
+    b.targetStart = block.getTargetStart();
+    b.targetStop  = block.getTargetStop();
+    b.queryStart  = block.getQueryStart();
+    b.queryStop   = block.getQueryStop();
+    b.reversed    = block.isReversed() ? 1 : 0;
+    records.push_back(b);
+  }
+
+  svec<int> targetRemap, queryRemap;
+  InternSorted(targetIds, blocks.targetChroms, targetRemap);
+  InternSorted(queryIds, blocks.queryChroms, queryRemap);
+  for (int i=0; i<records.isize(); i++) {
+    records[i].targetChrom = targetRemap[records[i].targetChrom];
+    records[i].queryChrom  = queryRemap[records[i].queryChrom];
+  }
+  blocks.Assign(records);
+  return true;
+}
+
+// Lock held while a synteny file is parsed and its sidecar written, one per file
+static std::mutex & ParseLock(const string & fileName)
+{
+  static std::mutex locksMutex;
+  static map<string, std::shared_ptr<std::mutex> > locks;
+  std::lock_guard<std::mutex> lock(locksMutex);
+  std::shared_ptr<std::mutex> & m = locks[fileName];
+  if (!m)
+    m.reset(new std::mutex);
+  return *m;
+}
+
+bool SyntenyCache::Read(const string & fileName, bool flip, SyntenyBlockSet & blocks)
+{
+  if (ReadCache(fileName, flip, blocks)) {
+    FILE_LOG(logDEBUG) << "Read synteny cache: " << CacheName(fileName);
+    return true;
+  }
+
+  // Both orientations of a file may be loaded at the same time, the second one waits
+  // for the first to write the sidecar rather than parsing the file again
+  std::lock_guard<std::mutex> lock(ParseLock(fileName));
+  if (ReadCache(fileName, flip, blocks)) {
+    FILE_LOG(logDEBUG) << "Read synteny cache: " << CacheName(fileName);
+    return true;
+  }
+
+  SyntenyBlockSet forward, flipped;
+  if (!Parse(fileName, forward)) {
+    FILE_LOG(logERROR) << "Could not read synteny file: " << fileName;
+    return false;
+  }
+  forward.Flip(flipped);
+  if (!WriteCache(fileName, forward, flipped))
+    FILE_LOG(logWARNING) << "Could not write synteny cache: " << CacheName(fileName);
+
+  if (flip)
+    swap(blocks, flipped);
+  else
+    swap(blocks, forward);
+  return true;
+}
+
+// Reads the zero terminated names starting at p and ending before end, returns the 
+// position after the last one or NULL if they run past end
+static const char * ReadNames(const char * p, const char * end, uint64_t count, svec<string> & names)
+{
+  if (count > (uint64_t)(end - p))
+    return NULL;
+  names.resize(count);
+  for (uint64_t i=0; i<count; i++) {
+    const char * stop = (const char *)memchr(p, 0, end - p);
+    if (stop == NULL)
+      return NULL;
+    names[i].assign(p, stop - p);
+    p = stop + 1;
+  }
+  return p;
+}
+
+// Arrays in the sidecar are padded to 8 bytes
+static uint64_t Padded(uint64_t bytes)
+{
+  return (bytes + 7) & ~((uint64_t)7);
+}
+
+// Bytes taken by one orientation with the given counts of target chromosomes and blocks
+static uint64_t SetBytes(uint64_t targetCount, uint64_t blockCount)
+{
+  return Padded((targetCount + 1) * sizeof(int32_t)) + 5 * Padded(blockCount * sizeof(int32_t)) 
+         + Padded(blockCount);
+}
+
+template<class T>
+static const char * ReadArray(const char * p, uint64_t count, svec<T> & out)
+{
+  out.resize(count);
+  if (count > 0)
+    memcpy(&out[0], p, count * sizeof(T));
+  return p + Padded(count * sizeof(T));
+}
+
+template<class T>
+static void WriteArray(FILE * pFile, const svec<T> & in)
+{
+  static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  uint64_t bytes = in.size() * sizeof(T);
+  if (bytes > 0)
+    fwrite(&in[0], 1, bytes, pFile);
+  fwrite(zeros, 1, Padded(bytes) - bytes, pFile);
+}
+
+static const char * ReadSet(const char * p, uint64_t blockCount, SyntenyBlockSet & blocks)
+{
+  p = ReadArray(p, blocks.targetChroms.size() + 1, blocks.chromOffset);
+  p = ReadArray(p, blockCount, blocks.targetStart);
+  p = ReadArray(p, blockCount, blocks.targetStop);
+  p = ReadArray(p, blockCount, blocks.queryChrom);
+  p = ReadArray(p, blockCount, blocks.queryStart);
+  p = ReadArray(p, blockCount, blocks.queryStop);
+  return ReadArray(p, blockCount, blocks.reversed);
+}
+
+static void WriteSet(FILE * pFile, const SyntenyBlockSet & blocks)
+{
+  WriteArray(pFile, blocks.chromOffset);
+  WriteArray(pFile, blocks.targetStart);
+  WriteArray(pFile, blocks.targetStop);
+  WriteArray(pFile, blocks.queryChrom);
+  WriteArray(pFile, blocks.queryStart);
+  WriteArray(pFile, blocks.queryStop);
+  WriteArray(pFile, blocks.reversed);
+}
+
+bool SyntenyCache::ReadCache(const string & fileName, bool flip, SyntenyBlockSet & blocks)
+{
+  struct stat st;
+  if (stat(fileName.c_str(), &st) != 0)
+    return false;
+  string cacheName = CacheName(fileName);
+  struct stat cacheSt;
+  if (stat(cacheName.c_str(), &cacheSt) != 0)
+    return false;
+  MappedFile file;
+  if (!file.Open(cacheName) || file.Size() < sizeof(SyntenyCacheHeader))
+    return false;
+  const SyntenyCacheHeader * header = reinterpret_cast<const SyntenyCacheHeader*>(file.Data());
+  if (memcmp(header->magic, CACHE_MAGIC, 8) != 0 || header->version != CACHE_VERSION) {
+    FILE_LOG(logDEBUG) << "Ignoring synteny cache of another version: " << cacheName;
+    return false;
+  }
+  if (header->sourceSize != (int64_t)st.st_size || header->sourceTime != (int64_t)st.st_mtime) {
+    FILE_LOG(logDEBUG) << "Ignoring stale synteny cache: " << cacheName;
+    return false;
+  }
+  // Counts are checked against the file size first so that the sizes below cannot overflow
+  uint64_t size = file.Size() - sizeof(SyntenyCacheHeader);
+  if (header->namesSize > size || header->blockCount > size 
+      || header->nameCount[0] > header->namesSize || header->nameCount[1] > header->namesSize) {
+    FILE_LOG(logWARNING) << "Ignoring corrupt synteny cache: " << cacheName;
+    return false;
+  }
+  uint64_t forwardBytes = SetBytes(header->nameCount[0], header->blockCount);
+  uint64_t flippedBytes = SetBytes(header->nameCount[1], header->blockCount);
+  if (size != header->namesSize + forwardBytes + flippedBytes) {
+    FILE_LOG(logWARNING) << "Ignoring truncated synteny cache: " << cacheName;
+    return false;
+  }
+
+  const char * names = file.Data() + sizeof(SyntenyCacheHeader);
+  const char * namesEnd = names + header->namesSize;
+  svec<string> first, second;
+  const char * p = ReadNames(names, namesEnd, header->nameCount[0], first);
+  if (p == NULL || ReadNames(p, namesEnd, header->nameCount[1], second) == NULL) {
+    FILE_LOG(logWARNING) << "Ignoring corrupt synteny cache: " << cacheName;
+    return false;
+  }
+  const char * data = namesEnd;
+  blocks.clear();
+  if (flip) {
+    data += forwardBytes;
+    swap(blocks.targetChroms, second);
+    swap(blocks.queryChroms, first);
+  } else {
+    swap(blocks.targetChroms, first);
+    swap(blocks.queryChroms, second);
+  }
+  ReadSet(data, header->blockCount, blocks);
+  if (!IsConsistent(blocks)) {
+    FILE_LOG(logWARNING) << "Ignoring corrupt synteny cache: " << cacheName;
+    blocks.clear();
+    return false;
+  }
+  return true;
+}
+
+bool SyntenyCache::IsConsistent(const SyntenyBlockSet & blocks)
+{
+  // The chromosome offsets and ids are used as indexes, the coordinates need no checks
+  const svec<int32_t> & offset = blocks.chromOffset;
+  if (offset.isize() != blocks.targetChroms.isize() + 1 || offset[0] != 0 
+      || offset[offset.isize()-1] != blocks.Size())
+    return false;
+  int i;
+  for (i=1; i<offset.isize(); i++) {
+    if (offset[i] < offset[i-1])
+      return false;
+  }
+  for (i=0; i<blocks.Size(); i++) {
+    if (blocks.queryChrom[i] < 0 || blocks.queryChrom[i] >= blocks.queryChroms.isize())
+      return false;
+  }
+  return true;
+}
+bool SyntenyCache::WriteCache(const string & fileName, const SyntenyBlockSet & forward, const SyntenyBlockSet & flipped)
+{
+  struct stat st;
+  if (stat(fileName.c_str(), &st) != 0)
+    return false;
+
+  SyntenyCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CACHE_MAGIC, 8);
+  header.version      = CACHE_VERSION;
+  header.sourceSize   = st.st_size;
+  header.sourceTime   = st.st_mtime;
+  header.nameCount[0] = forward.targetChroms.size();
+  header.nameCount[1] = forward.queryChroms.size();
+  header.blockCount   = forward.Size();
+  string names;
+  int i;
+  for (i=0; i<forward.targetChroms.isize(); i++) {
+    names += forward.targetChroms[i];
+    names += '\0';
+  }
+  for (i=0; i<forward.queryChroms.isize(); i++) {
+    names += forward.queryChroms[i];
+    names += '\0';
+  }
+  names.resize((names.size() + 7) & ~((size_t)7), '\0');
+  header.namesSize = names.size();
+
+  // Write to a temporary file first so that concurrent readers never see a partial sidecar
+  static std::atomic<int> tmpCount(0);
+  string cacheName = CacheName(fileName);
+  stringstream tmpName;
+  tmpName << cacheName << "." << getpid() << "." << tmpCount++ << ".tmp";
+  FILE * pFile = fopen(tmpName.str().c_str(), "wb");
+  if (pFile == NULL)
+    return false;
+  fwrite(&header, sizeof(header), 1, pFile);
+  fwrite(names.c_str(), 1, names.size(), pFile);
+  WriteSet(pFile, forward);
+  WriteSet(pFile, flipped);
+  bool ok = (ferror(pFile) == 0);
+  ok = (fclose(pFile) == 0) && ok;
+  if (!ok || rename(tmpName.str().c_str(), cacheName.c_str()) != 0) {
+    remove(tmpName.str().c_str());
+    return false;
+  }
+  FILE_LOG(logDEBUG) << "Wrote synteny cache: " << cacheName;
+  return true;
+}
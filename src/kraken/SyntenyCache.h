@@ -0,0 +1,113 @@
+#ifndef _SYNTENYCACHE_H_
+#define _SYNTENYCACHE_H_
+
+#include <stdint.h>
+#include "ryggrad/src/base/SVector.h"
+#include "SearchIndex.h"
+
+//======================================================
+/**
+ * Single synteny block with the chromosomes given as ids into the name tables of
+ * a SyntenyBlockSet. As in AlignmentBlock, target is the side that is looked up
+ * and query the side that is mapped to. Only used while building a set, the set
+ * itself keeps its blocks as parallel arrays.
+ */
+struct SyntenyBlock
+{
+  SyntenyBlock(): targetChrom(-1), targetStart(-1), targetStop(-1),
+                  queryChrom(-1), queryStart(-1), queryStop(-1), reversed(0) {}
+
+  bool operator < (const SyntenyBlock & b) const {
+    if (targetChrom != b.targetChrom) return (targetChrom < b.targetChrom);
+    if (targetStart != b.targetStart) return (targetStart < b.targetStart);
+    if (targetStop  != b.targetStop)  return (targetStop  < b.targetStop);
+    if (queryChrom  != b.queryChrom)  return (queryChrom  < b.queryChrom);
+    return (queryStart < b.queryStart);
+  }
+
+  int32_t targetChrom;
+  int32_t targetStart;
+  int32_t targetStop;
+  int32_t queryChrom;
+  int32_t queryStart;
+  int32_t queryStop;
+  char    reversed;     /// 1 if the query side is on the reverse strand
+};
+
+//======================================================
+/**
+ * Sorted synteny blocks of one orientation of a synteny file, stored as parallel
+ * arrays so that the search over the target starts only touches one contiguous
+ * array of integers. Blocks are grouped by target chromosome, the blocks of
+ * chromosome c being [ChromBegin(c), ChromEnd(c)). The chromosome names are
+ * interned in sorted order, so ordering by id is ordering by name.
+ */
+struct SyntenyBlockSet
+{
+  /** Id of the given target chromosome, -1 if there is no block on it */
+  int TargetChromId(const string & chr) const;
+
+  int Size() const               { return targetStart.isize(); }
+  int ChromBegin(int chr) const  { return chromOffset[chr];     }
+  int ChromEnd(int chr) const    { return chromOffset[chr+1];   }
+  /** Target chromosome id of block i */
+  int TargetChrom(int i) const;
+  /** Copy of block i as a single record */
+  SyntenyBlock Block(int i) const;
+
+  /** Sorts the given blocks and stores them (the name tables have to be set already) */
+  void Assign(svec<SyntenyBlock> & records);
+
+  /** Builds the per chromosome search indexes over the target starts */
+  void BuildSearchIndex();
+  /** 
+   * Index of the first block on chromosome chr starting at or after pos. Uses the search 
+   * index if it is built and useIndex is set, a binary search over the target starts otherwise.
+   */
+  int LowerBound(int chr, int pos, bool useIndex = true) const;
+
+  /** Same blocks with target and query swapped, i.e. for mapping in the other direction */
+  void Flip(SyntenyBlockSet & flipped) const;
+
+  void clear();
+
+  svec<string>  targetChroms;   /// Sorted names of the target chromosomes
+  svec<string>  queryChroms;    /// Sorted names of the query chromosomes
+  svec<int32_t> chromOffset;    /// First block of each target chromosome, followed by the block count
+  svec<int32_t> targetStart;
+  svec<int32_t> targetStop;
+  svec<int32_t> queryChrom;     /// Ids into queryChroms
+  svec<int32_t> queryStart;
+  svec<int32_t> queryStop;
+  svec<char>    reversed;       /// 1 if the query side is on the reverse strand
+  svec<EytzingerIndex> searchIndex;  /// Index over the target starts of each target chromosome (not cached)
+};
+
+//======================================================
+/**
+ * Binary sidecar of a synteny (satsuma) file holding its parsed and sorted
+ * blocks in both orientations. The sidecar is written next to the text file
+ * on first load and memory mapped on later loads, as long as the size and
+ * modification time of the text file have not changed.
+ */
+class SyntenyCache
+{
+public:
+  /**
+   * Gets the blocks of fileName, flipped if the source genome is in the second set of columns.
+   * Uses the sidecar if it is up to date, otherwise parses the file and writes the sidecar.
+   */
+  static bool Read(const string & fileName, bool flip, SyntenyBlockSet & blocks);
+
+  /** Name of the sidecar for the given synteny file */
+  static string CacheName(const string & fileName) { return fileName + ".kbc"; }
+
+private:
+  static bool Parse(const string & fileName, SyntenyBlockSet & blocks);
+  static bool ReadCache(const string & fileName, bool flip, SyntenyBlockSet & blocks);
+  /** Checks that the chromosome offsets and ids read from a sidecar are usable as indexes */
+  static bool IsConsistent(const SyntenyBlockSet & blocks);
+  static bool WriteCache(const string & fileName, const SyntenyBlockSet & forward, const SyntenyBlockSet & flipped);
+};
+
+#endif //_SYNTENYCACHE_H_
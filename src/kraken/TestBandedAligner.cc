@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <random>
+#include <string>
+#include "ryggrad/src/base/CommandLineParser.h"
+#include "cola/src/cola/Cola.h"
+#include "BandedAligner.h"
+
+// Regression test of the banded aligner: every kernel against a plain dynamic programming
+// over the full matrix, and the aligned stretches against cola's SWGA with the parameters
+// ExhaustAlign uses, so that its banded pass and cola can not drift apart unnoticed.
+
+static const int NEG_SCORE = -(1 << 29);
+
+static void ToDNA(const string & bases, DNAVector & out)
+{
+  out.resize((int)bases.size());
+  for (int i=0; i<(int)bases.size(); i++)
+    out[i] = bases[i];
+}
+
+static string RandomBases(std::mt19937 & rng, int len, bool withN)
+{
+  string s;
+  for (int i=0; i<len; i++)
+    s += "ACGTN"[rng() % ((withN && rng() % 10 == 0) ? 5 : 4)];
+  return s;
+}
+
+static string ReverseComplement(const string & s)
+{
+  string rc;
+  for (int i=(int)s.size()-1; i>=0; i--)
+    rc += DNAView::Complement(s[i]);
+  return rc;
+}
+
+/**
+ * Smith-Waterman over the full matrix, with the cells of q[i], t[j] outside of
+ * lowDiag <= j - i + diagOffset <= highDiag left out. Ties go to the first cell
+ * by anti-diagonal and query position, as in BandedAligner.
+ */
+static BandedScore NaiveAlign(const string & q, const string & t, int lowDiag, int highDiag, int diagOffset = 0)
+{
+  int m = (int)q.size();
+  int n = (int)t.size();
+  svec< svec<int> > h, e, f;
+  h.resize(m+1);
+  e.resize(m+1);
+  f.resize(m+1);
+  for (int i=0; i<=m; i++) {
+    h[i].resize(n+1, 0);
+    e[i].resize(n+1, NEG_SCORE);
+    f[i].resize(n+1, NEG_SCORE);
+  }
+  // Cells outside of the matrix or the band score 0 and have no gap to extend
+  auto inBand = [&](int i, int j) { return i >= 0 && j >= 0 && j-i+diagOffset >= lowDiag && j-i+diagOffset <= highDiag; };
+  BandedScore best;
+  for (int d=0; d<m+n-1; d++) {
+    for (int i=0; i<m; i++) {
+      int j = d - i;
+      if (j < 0 || j >= n || !inBand(i, j))
+        continue;
+      bool match = (q[i] == t[j] && q[i] != 'N');
+      int diag  = (inBand(i-1, j-1) ? h[i][j] : 0) + (match ? 1 : -1);
+      int left  = std::max((inBand(i, j-1) ? h[i+1][j] : 0) - 5, (inBand(i, j-1) ? e[i+1][j] : NEG_SCORE) - 2);
+      int up    = std::max((inBand(i-1, j) ? h[i][j+1] : 0) - 5, (inBand(i-1, j) ? f[i][j+1] : NEG_SCORE) - 2);
+      int score = std::max(std::max(0, diag), std::max(left, up));
+      h[i+1][j+1] = score;
+      e[i+1][j+1] = left;
+      f[i+1][j+1] = up;
+      if (score > best.score) {
+        best.score     = score;
+        best.queryEnd  = i;
+        best.targetEnd = j;
+      }
+    }
+  }
+  return best;
+}
+
+// Checks one alignment of all kernels against the plain one, returns the number of failures
+static int CheckKernels(BandedAligner & aligner, const string & q, const string & t, int bound)
+{
+  DNAVector query, target;
+  ToDNA(q, query);
+  ToDNA(t, target);
+  BandedScore expected = NaiveAlign(q, t, -bound, bound);
+  int failures = 0;
+  for (int k=BandedAligner::SCALAR; k<=BandedAligner::BestKernel(); k++) {
+    aligner.SetKernel((BandedAligner::Kernel)k);
+    BandedScore got = aligner.Align(query, target, bound);
+    bool ok = (got.score == expected.score && got.queryEnd == expected.queryEnd && got.targetEnd == expected.targetEnd);
+    if (ok && got.score > 0) {
+      // The start has to be the one of an alignment with the best score ending at the end found
+      string qs = q.substr(got.queryStart, got.QueryAligned());
+      string ts = t.substr(got.targetStart, got.TargetAligned());
+      BandedScore sub = NaiveAlign(qs, ts, -bound, bound, got.targetStart - got.queryStart);
+      ok = (got.queryStart >= 0 && got.targetStart >= 0 && sub.score == expected.score
+            && sub.queryEnd == got.QueryAligned()-1 && sub.targetEnd == got.TargetAligned()-1);
+    }
+    if (!ok) {
+      cout << "Kernel " << BandedAligner::KernelName((BandedAligner::Kernel)k) << " differs on " << q << " / " << t
+           << " bound " << bound << ": score " << got.score << " (" << expected.score << "), ends " << got.queryEnd
+           << "," << got.targetEnd << " (" << expected.queryEnd << "," << expected.targetEnd << ")" << endl;
+      failures++;
+    }
+  }
+  aligner.SetKernel(BandedAligner::BestKernel());
+  return failures;
+}
+
+// Aligns the way ExhaustAlign does (cola's target is the source, its query the destination)
+// and compares where either side of the alignment starts and how much of it is covered
+static int CheckCola(BandedAligner & aligner, const string & name, const string & source, const string & destination, int slack)
+{
+  DNAVector src, dest;
+  ToDNA(source, src);
+  ToDNA(destination, dest);
+  int bound = std::min(src.isize()/20, 20) + slack;
+  Cola cola;
+  AlignmentCola reference = cola.createAlignment(src, dest, AlignerParams(bound, SWGA, -5, -2, -1));
+  BandedScore got = aligner.Align(src, dest, bound);
+  if (got.queryStart  != reference.getTargetOffset() || got.QueryAligned()  != reference.getTargetBaseAligned() ||
+      got.targetStart != reference.getQueryOffset()  || got.TargetAligned() != reference.getQueryBaseAligned()) {
+    cout << "Cola differs on " << name << ": source " << got.queryStart << "+" << got.QueryAligned() << " ("
+         << reference.getTargetOffset() << "+" << reference.getTargetBaseAligned() << "), destination "
+         << got.targetStart << "+" << got.TargetAligned() << " (" << reference.getQueryOffset() << "+"
+         << reference.getQueryBaseAligned() << ")" << endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc,char** argv)
+{
+  commandArg<int> iterCmmd("-n", "Number of random alignments per check", 500);
+  commandArg<int> seedCmmd("-s", "Random seed", 1);
+  commandLineParser P(argc,argv);
+  P.SetDescription("Checks the banded aligner kernels against a plain alignment and against cola.");
+  P.registerArg(iterCmmd);
+  P.registerArg(seedCmmd);
+  P.parse();
+  int iterations = P.GetIntValueFor(iterCmmd);
+  int seed       = P.GetIntValueFor(seedCmmd);
+
+  std::mt19937 rng(seed);
+  BandedAligner aligner;
+  int failures = 0;
+  int i;
+
+  // Random pairs, half of them related by substitutions and a deletion, with bands from empty to wide
+  for (i=0; i<iterations; i++) {
+    string q = RandomBases(rng, 1 + rng() % 300, true);
+    string t;
+    if (rng() % 2) {
+      t = RandomBases(rng, rng() % 10, true);
+      for (int k=0; k<(int)q.size(); k++)
+        t += (rng() % 8 == 0 ? "ACGT"[rng() % 4] : q[k]);
+      if (rng() % 3 == 0)
+        t.erase(rng() % t.size(), rng() % 4);
+      t += RandomBases(rng, rng() % 10, true);
+    } else {
+      t = RandomBases(rng, 1 + rng() % 60, true);
+    }
+    if (t.empty())
+      t = "A";
+    failures += CheckKernels(aligner, q, t, rng() % 70);
+  }
+
+  // Views of parts of either strand align like copies of the same bases
+  for (i=0; i<iterations; i++) {
+    string q = RandomBases(rng, 20 + rng() % 200, false);
+    string t = RandomBases(rng, 5, false) + q.substr(5, q.size()/2) + RandomBases(rng, 5, false);
+    DNAVector query, target;
+    ToDNA(q, query);
+    ToDNA(t, target);
+    int start = rng() % q.size();
+    int len   = 1 + rng() % (q.size() - start);
+    int bound = rng() % 30;
+    string sub = q.substr(start, len);
+    BandedScore forward = aligner.Align(DNAView(query).Sub(start, len), target, bound);
+    BandedScore reverse = aligner.Align(DNAView(query, true).Sub((int)q.size() - start - len, len), target, bound);
+    BandedScore expectedForward = NaiveAlign(sub, t, -bound, bound);
+    BandedScore expectedReverse = NaiveAlign(ReverseComplement(sub), t, -bound, bound);
+    if (forward.score != expectedForward.score || forward.queryEnd != expectedForward.queryEnd ||
+        reverse.score != expectedReverse.score || reverse.queryEnd != expectedReverse.queryEnd) {
+      cout << "View of " << start << "+" << len << " differs from its copy on " << q << " / " << t << endl;
+      failures++;
+    }
+  }
+
+  // Against cola, on sources placed in a destination with slack on either side, as ExhaustAlign gets them.
+  // The flanks never match so that the ends of the best alignment are unique.
+  const int slack = 20;
+  string flank(slack, 'N');
+  string a = RandomBases(rng, 100, false);
+  string b = RandomBases(rng, 10, false);
+  failures += CheckCola(aligner, "exact copy", a, flank + a + flank, slack);
+  string mutated = a;
+  for (i=6; i<(int)mutated.size(); i+=13)
+    mutated[i] = (mutated[i] == 'A' ? 'C' : 'A');
+  failures += CheckCola(aligner, "substitutions", a, flank + mutated + flank, slack);
+  failures += CheckCola(aligner, "deletion", a + b, flank + a.substr(0, 60) + a.substr(64) + b + flank, slack);
+  failures += CheckCola(aligner, "offset", a, flank.substr(0, 7) + a.substr(10) + flank, slack);
+  // A 3 base insertion before 10 matching bases costs 9 if a gap of length L scores open + (L-1)*extend,
+  // so the alignment goes on across it, but 11 if it scores open + L*extend, so the alignment stops before it
+  failures += CheckCola(aligner, "gap model", a + b, flank + a + "TTT" + b + flank, slack);
+  BandedScore gapModel;
+  {
+    DNAVector src, dest;
+    ToDNA(a + b, src);
+    ToDNA(flank + a + "TTT" + b + flank, dest);
+    gapModel = aligner.Align(src, dest, std::min(src.isize()/20, 20) + slack);
+  }
+  if (gapModel.QueryAligned() != (int)(a + b).size()) {
+    cout << "The alignment should extend across the insertion, it covers " << gapModel.QueryAligned() << " bases" << endl;
+    failures++;
+  }
+
+  if (failures > 0) {
+    cout << failures << " checks failed" << endl;
+    return 1;
+  }
+  cout << "All checks passed" << endl;
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include <random>
+#include <string>
+#include "ryggrad/src/base/CommandLineParser.h"
+#include "DNAView.h"
+
+// Regression test of DNAView: forward and reversed views, and sub-views of them, against copies
+// made with DNAVector::SetToSubOf and DNAVector::ReverseComplement, on sequences with IUPAC
+// ambiguity codes and soft-masked bases, which reverse strand windows have to keep as before.
+
+static const char BASES[] = "ACGTNRYKMBVDHSWacgtnrykmbvdhsw";
+
+static void ToDNA(const string & bases, DNAVector & out)
+{
+  out.resize((int)bases.size());
+  for (int i=0; i<(int)bases.size(); i++)
+    out[i] = bases[i];
+}
+
+static string ToString(const DNAView & view)
+{
+  string s;
+  for (int i=0; i<view.isize(); i++)
+    s += view[i];
+  return s;
+}
+
+static string ToString(const DNAVector & seq)
+{
+  string s;
+  for (int i=0; i<seq.isize(); i++)
+    s += seq[i];
+  return s;
+}
+
+// The bases of seq from start on, reverse complemented by DNAVector if reversed
+static string Expected(const DNAVector & seq, int start, int len, bool reversed)
+{
+  DNAVector sub;
+  sub.SetToSubOf(seq, start, len);
+  if (reversed)
+    sub.ReverseComplement();
+  return ToString(sub);
+}
+
+int main(int argc,char** argv)
+{
+  commandArg<int> iterCmmd("-n", "Number of random sequences", 2000);
+  commandArg<int> seedCmmd("-s", "Random seed", 1);
+  commandLineParser P(argc,argv);
+  P.SetDescription("Checks forward and reversed DNA views against DNAVector copies, IUPAC codes included.");
+  P.registerArg(iterCmmd);
+  P.registerArg(seedCmmd);
+  P.parse();
+  int iterations = P.GetIntValueFor(iterCmmd);
+  int seed       = P.GetIntValueFor(seedCmmd);
+
+  int failures = 0;
+
+  // Every code once, with the reverse complement written out
+  DNAVector codes;
+  ToDNA("ACGTRYKMBVDHNSWacgtrykmbvdhnsw", codes);
+  string expectedRC = "wsndhbvkmryacgtWSNDHBVKMRYACGT";
+  if (ToString(DNAView(codes, true)) != expectedRC) {
+    cout << "Reversed view of all codes: " << ToString(DNAView(codes, true)) << ", expected " << expectedRC << endl;
+    failures++;
+  }
+
+  std::mt19937 rng(seed);
+  for (int i=0; i<iterations; i++) {
+    string bases;
+    int len = 1 + rng() % 200;
+    for (int k=0; k<len; k++)
+      bases += BASES[rng() % (sizeof(BASES) - 1)];
+    DNAVector seq;
+    ToDNA(bases, seq);
+
+    // A window of the sequence on either strand, a sub-view of it, and that on the other strand
+    int start    = rng() % len;
+    int wlen     = rng() % (len - start + 1);
+    bool reverse = (rng() % 2 == 0);
+    DNAView window(seq, start, wlen, reverse);
+    if (ToString(window) != Expected(seq, start, wlen, reverse)) {
+      cout << "Window " << start << "+" << wlen << (reverse ? " (reversed)" : "") << " of " << bases << endl;
+      failures++;
+      continue;
+    }
+    int subStart = (wlen > 0 ? rng() % wlen : 0);
+    int subLen   = rng() % (wlen - subStart + 1);
+    DNAView sub  = window.Sub(subStart, subLen);
+    // Positions of the sub-view on the forward strand
+    int fwdStart = (reverse ? start + wlen - subStart - subLen : start + subStart);
+    if (ToString(sub) != Expected(seq, fwdStart, subLen, reverse)
+        || ToString(sub.ReverseComplement()) != Expected(seq, fwdStart, subLen, !reverse)) {
+      cout << "Sub-view " << subStart << "+" << subLen << " of window " << start << "+" << wlen
+           << (reverse ? " (reversed)" : "") << " of " << bases << endl;
+      failures++;
+      continue;
+    }
+    DNAVector scratch;
+    if (ToString(sub.Materialize(scratch)) != ToString(sub)) {
+      cout << "Materialized sub-view differs from the view of " << bases << endl;
+      failures++;
+    }
+  }
+
+  if (failures > 0) {
+    cout << failures << " checks failed" << endl;
+    return 1;
+  }
+  cout << "All checks passed" << endl;
+  return 0;
+}
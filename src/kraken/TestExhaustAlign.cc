@@ -0,0 +1,140 @@
+#include <string>
+#include "ryggrad/src/base/CommandLineParser.h"
+#include "ryggrad/src/base/Logger.h"
+#include "cola/src/cola/Cola.h"
+#include "../annotationQuery/AnnotationQuery.h"
+#include "KrakenConfig.h"
+#include "KrakenMap.h"
+
+// Regression test of the exhaustive alignment on the sample data: the annotation items are mapped,
+// and each source is aligned against its mapped region (with the slack Refine adds) and against the
+// region of the next item. The decision and offsets ExhaustAlign used to take from cola alone have to
+// match the ones it takes now: the cover bound on the banded alignment, which rejects candidates
+// before cola runs, then cola's p-value and identity, with offsets and spans from the banded aligner.
+
+/** What ExhaustAlign takes from an alignment of a source against a destination with slack */
+struct AlignedRegion
+{
+  bool accepted;
+  int sourceStart;
+  int sourceAligned;
+  int destStart;
+  int destAligned;
+};
+
+static int CheckPair(BandedAligner & banded, const string & name, const DNAVector & source,
+                     const DNAVector & destination, int slack, const KrakenParams & params, int & bounded)
+{
+  int bound = min(source.isize()/20, 20) + slack;
+  Cola cola;
+  AlignmentCola pAlign = cola.createAlignment(source, destination, AlignerParams(bound, SWGA, -5, -2, -1));
+  BandedScore aligned = banded.Align(source, destination, bound);
+  bool passesCola = (pAlign.calcPVal() <= params.getPValThresh() && pAlign.calcIdentityScore() >= params.getMinIdent());
+
+  // In cola's terms the source is the target and the destination the query
+  AlignedRegion before = {(double)pAlign.getTargetBaseAligned()/source.isize() >= params.getMinAlignCover() && passesCola,
+                          pAlign.getTargetOffset(), pAlign.getTargetBaseAligned(),
+                          pAlign.getQueryOffset(), pAlign.getQueryBaseAligned()};
+  bool coverBound = ((double)aligned.QueryAligned()/source.isize() < params.getMinAlignCover());
+  if (coverBound)
+    bounded++;
+  AlignedRegion after  = {!coverBound && passesCola,
+                          aligned.queryStart, aligned.QueryAligned(), aligned.targetStart, aligned.TargetAligned()};
+  if (before.accepted != after.accepted) {
+    cout << name << ": " << (before.accepted ? "accepted" : "rejected") << " with cola alone, "
+         << (after.accepted ? "accepted" : "rejected") << (coverBound ? " by the cover bound" : "") << endl;
+    return 1;
+  }
+  // Offsets only matter for accepted alignments
+  if (after.accepted && (before.sourceStart != after.sourceStart || before.sourceAligned != after.sourceAligned ||
+                         before.destStart != after.destStart || before.destAligned != after.destAligned)) {
+    cout << name << ": source " << after.sourceStart << "+" << after.sourceAligned << " (cola "
+         << before.sourceStart << "+" << before.sourceAligned << "), destination " << after.destStart << "+"
+         << after.destAligned << " (cola " << before.destStart << "+" << before.destAligned << ")" << endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc,char** argv)
+{
+  commandArg<string> configCmmd("-c", "Configuration file (e.g. sample/dere_dyak_dmel.config, run from its directory)");
+  commandArg<string> gtfCmmd("-s", "Source GTF file");
+  commandArg<string> sourceCmmd("-S", "Source genome id");
+  commandArg<string> targetCmmd("-T", "Target genome id");
+  commandLineParser P(argc,argv);
+  P.SetDescription("Checks the banded exhaustive alignment against cola on the items of an annotation.");
+  P.registerArg(configCmmd);
+  P.registerArg(gtfCmmd);
+  P.registerArg(sourceCmmd);
+  P.registerArg(targetCmmd);
+  P.parse();
+  string configFile = P.GetStringValueFor(configCmmd);
+  string gtfFile    = P.GetStringValueFor(gtfCmmd);
+  string sourceName = P.GetStringValueFor(sourceCmmd);
+  string targetName = P.GetStringValueFor(targetCmmd);
+  FILELog::ReportingLevel() = logWARNING;
+
+  Kraken mapper;
+  KrakenConfig config(&mapper);
+  if (!config.Configure(configFile)) {
+    cout << "Could not read the configuration " << configFile << endl;
+    return 1;
+  }
+  int source = mapper.GenomeId(sourceName);
+  int target = mapper.GenomeId(targetName);
+  if (source < 0 || target < 0) {
+    cout << "Unknown genome " << (source < 0 ? sourceName : targetName) << endl;
+    return 1;
+  }
+  const GenomeSeq & sourceGenome = mapper.GetGenomes()[source];
+  const GenomeSeq & targetGenome = mapper.GetGenomes()[target];
+  Annotation annot(gtfFile, sourceName);
+  const svec<AnnotItemBase*> & items = annot.getDataByCoord(AITEM);
+
+  // Sources and their mapped regions, widened by the slack Refine gives the exhaustive alignment
+  const int slack = 12;
+  MapperContext ctx;
+  svec<DNAVector> sources, destinations;
+  svec<string> names;
+  for (int i=0; i<items.isize(); i++) {
+    Coordinate mapped;
+    if (!mapper.Find(items[i]->getCoords(), source, target, mapped, ctx))
+      continue;
+    int chrSize = targetGenome.ChromosomeSize(mapped.getChr());
+    mapped.setStart(max(0, mapped.getStart() - slack));
+    mapped.setStop(min(chrSize - 1, mapped.getStop() + slack));
+    sources.push_back(DNAVector());
+    destinations.push_back(DNAVector());
+    if (!sourceGenome.SetSequence(items[i]->getCoords(), sources.back())
+        || !targetGenome.SetSequence(mapped, destinations.back())) {
+      sources.pop_back();
+      destinations.pop_back();
+      continue;
+    }
+    names.push_back(items[i]->getCoords().toString('\t'));
+  }
+  if (sources.empty()) {
+    cout << "No items of " << gtfFile << " mapped" << endl;
+    return 1;
+  }
+
+  // Every source against its own region, which mostly passes, and against the next one's, which mostly fails
+  KrakenParams params;
+  BandedAligner banded;
+  int failures = 0, bounded = 0;
+  for (int i=0; i<sources.isize(); i++) {
+    int next = (i + 1) % sources.isize();
+    failures += CheckPair(banded, names[i], sources[i], destinations[i], slack, params, bounded);
+    failures += CheckPair(banded, names[i] + " against the region of " + names[next], sources[i], destinations[next], slack, params, bounded);
+  }
+
+  cout << "Pairs: " << 2*sources.isize() << " from " << items.isize() << " items, "
+       << bounded << " rejected by the cover bound" << endl;
+  if (failures > 0) {
+    cout << failures << " checks failed" << endl;
+    return 1;
+  }
+  cout << "All checks passed" << endl;
+  return 0;
+}